@@ -4,6 +4,7 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "input_structures.glsl"
+#include "lights.glsl"
 
 struct blinn_inst {
 	vec4 color_factors;
@@ -34,25 +35,32 @@ void main() {
     vec3 diffuse_constants = in_color;
     vec3 diffuse_color = diffuse_constants * texture(textures[nonuniformEXT(in_color_id)], in_uv).rgb;
 
-    vec3 light_dir = frame_data.light.position.xyz - in_position;
-    float dist = length(light_dir);
-    float attenuation = 1 / (dist * dist);
-    light_dir = normalize(light_dir);
-    
     vec3 normal = normalize(in_normal);
+    vec3 view_dir = normalize(frame_data.view_pos.xyz - in_position);
 
-    float lambertian = max(dot(light_dir, normal), 0.0f);
-    vec3 diffuse = lambertian * diffuse_color;
+    // Ambient light is added once, not per light
+    vec3 color_linear = ambient * diffuse_color;
+    uint cluster = light_cluster(gl_FragCoord.xy, in_position);
+    uint light_count = light_counts[cluster];
+    for (uint i = 0; i < light_count; ++i) {
+        point_light light = lights[cluster_light(cluster, i)];
+        vec3 light_dir = light.position.xyz - in_position;
+        float dist = length(light_dir);
+        float attenuation = light_attenuation(dist, light.position.w);
+        light_dir = normalize(light_dir);
 
-    vec3 view_dir = normalize(frame_data.view_pos.xyz - in_position);
-    vec3 halfway_dir = normalize(light_dir + view_dir);
-    float spec = pow(max(dot(normal, halfway_dir), 0.0f), shininess);
+        float lambertian = max(dot(light_dir, normal), 0.0f);
+        vec3 diffuse = lambertian * diffuse_color;
+
+        vec3 halfway_dir = normalize(light_dir + view_dir);
+        float spec = pow(max(dot(normal, halfway_dir), 0.0f), shininess);
 
-    vec3 specular = specular_color * spec; // assuming bright white light color
+        vec3 specular = specular_color * spec; // assuming bright white light color
 
-    vec3 color_linear = (ambient * attenuation) + 
-        (diffuse * frame_data.light.color.rgb * frame_data.light.color.w * attenuation) +
-        (specular * frame_data.light.color.rgb * frame_data.light.color.w * attenuation);
+        color_linear +=
+            (diffuse * light.color.rgb * light.color.w * attenuation) +
+            (specular * light.color.rgb * light.color.w * attenuation);
+    }
 
     vec3 gamma_corrected = pow(color_linear, vec3(1.0f / screen_gamma));
 
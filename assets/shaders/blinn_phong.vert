@@ -2,6 +2,7 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "input_structures.glsl"
+#include "draw_constants.glsl"
 // SET 1: Material descriptors
 
 // This needs to be present in each created material
@@ -23,17 +24,19 @@ layout (location = 2) out vec3 out_color;
 layout (location = 3) out vec2 out_uv;
 layout (location = 4) flat out uint out_color_id;
 
+// Bit identical to the depth prepass position, the geometry pass tests EQUAL against it
+invariant gl_Position;
+
 void main() {
-    draw_command draw = blinn_draws[gl_DrawID];
-    vertex v = vertices[gl_VertexIndex];
-    mat4 model = transforms[draw.transform_id];
+    draw_command draw = blinn_draws[draw_push.draw_offset + gl_DrawID];
+    vertex v = unpack_vertex(gl_VertexIndex, geometries[draw.geo_id]);
+    mat4 model = load_transform(instances[gl_InstanceIndex]);
 
     gl_Position = frame_data.viewproj * model * vec4(v.position, 1.0f);
 
     out_position = (model * vec4(v.position, 1.0f)).xyz;
 
-    // TODO: Compute the normal matrix on the CPU and not GPU
-    out_normal = (transpose(inverse(model)) * vec4(v.normal, 0.0f)).xyz;
+    out_normal = normal_matrix(model) * v.normal;
 
     out_color = v.color.rgb * mat_insts[draw.material_id].color_factors.rgb;
     out_uv.x = v.uv_x;
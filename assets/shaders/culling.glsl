@@ -0,0 +1,156 @@
+// NOTE: Requires input_structures.glsl to be included first
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+// Culling stats, offsets from frame_data.cull_stats_id
+#define CULL_STAT_FRUSTUM 0
+#define CULL_STAT_SHADOW 1
+#define CULL_STAT_OCCLUSION 2
+#define CULL_STAT_CLUSTER 3
+#define CULL_STAT_DRAW_OVERFLOW 4	// Draws dropped past the capacity of their draw buffer
+#define CULL_STAT_LIGHT_OVERFLOW 5	// Froxels that dropped lights past LIGHT_CLUSTER_MAX_LIGHTS
+
+// Counts the calling invocations into a culling stat with one atomic per subgroup
+void count_culled(uint stat) {
+	uvec4 ballot = subgroupBallot(true);
+	if (subgroupElect()) {
+		atomicAdd(counts[frame_data.cull_stats_id + stat], subgroupBallotBitCount(ballot));
+	}
+}
+
+// Sphere transformed to world space.
+// The radius is scaled by the largest axis scale so non uniform scaling stays conservative
+vec4 transform_sphere(mat4 transform, vec4 sphere) {
+	vec3 center = vec3(transform * vec4(sphere.xyz, 1.0f));
+	float scale = max(
+		max(length(transform[0].xyz), length(transform[1].xyz)),
+		length(transform[2].xyz)
+	);
+	return vec4(center, sphere.w * scale);
+}
+
+// Bounding sphere of the geometry's AABB transformed to world space.
+vec4 world_bounding_sphere(mat4 transform, geometry geo) {
+	return transform_sphere(transform, vec4(geo.origin.xyz, geo.radius));
+}
+
+// Planes point into the frustum & are normalized, so the sphere is outside when it is
+// further than its radius behind any plane. Conservative: no false negatives.
+bool sphere_in_frustum(vec4 sphere, vec4 planes[6]) {
+	for (uint i = 0; i < 6; ++i) {
+		if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Screen space rect (min uv, max uv) & nearest depth of the geometry's AABB projected by mvp.
+// Returns false when a corner is behind the camera, nothing can be said about occlusion then
+bool project_bounds(mat4 mvp, geometry geo, out vec4 rect, out float nearest) {
+	rect = vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	nearest = 0.0f;
+	for (uint i = 0; i < 8; ++i) {
+		vec3 corner_sign = vec3(
+			(i & 1) != 0 ? 1.0f : -1.0f,
+			(i & 2) != 0 ? 1.0f : -1.0f,
+			(i & 4) != 0 ? 1.0f : -1.0f
+		);
+		vec4 clip = mvp * vec4(geo.origin.xyz + geo.extent.xyz * corner_sign, 1.0f);
+		if (clip.w <= 1e-4f) {
+			return false;
+		}
+		vec3 ndc = clip.xyz / clip.w;
+		vec2 uv = ndc.xy * 0.5f + 0.5f;
+		rect.xy = min(rect.xy, uv);
+		rect.zw = max(rect.zw, uv);
+		// Reverse-Z: the nearest depth is the largest
+		nearest = max(nearest, ndc.z);
+	}
+	rect = clamp(rect, 0.0f, 1.0f);
+	return true;
+}
+
+// The pyramid holds the farthest depth per texel & is sampled with a min reduction sampler.
+// The level is picked so the rect covers at most 2x2 texels, which the bilinear footprint
+// reduces in a single fetch. Conservative: an object is only occluded when its nearest
+// point is behind the farthest occluder depth over its whole rect.
+bool occluded_by_pyramid(mat4 viewproj, mat4 transform, geometry geo, sampler2D pyramid) {
+	vec4 rect;
+	float nearest;
+	if (!project_bounds(viewproj * transform, geo, rect, nearest)) {
+		return false;
+	}
+	vec2 size = (rect.zw - rect.xy) * vec2(textureSize(pyramid, 0));
+	float level = ceil(log2(max(max(size.x, size.y), 1.0f)));
+	float depth = textureLod(pyramid, (rect.xy + rect.zw) * 0.5f, level).x;
+	return nearest < depth;
+}
+
+// True when every triangle of the cluster faces away from the camera. Tests against the
+// bounding sphere instead of the cone apex, which is conservative. The cone axis is
+// transformed like a normal, a cutoff of 1 is never backfacing.
+bool cone_backfacing(mat4 transform, vec4 world_sphere, vec4 cone, vec3 camera) {
+	if (cone.w >= 1.0f) {
+		return false;
+	}
+	vec3 axis = normalize(normal_matrix(transform) * cone.xyz);
+	vec3 to_center = world_sphere.xyz - camera;
+	return dot(to_center, axis) >= cone.w * length(to_center) + world_sphere.w;
+}
+
+// Screen space rect (min uv, max uv) of a world space sphere, bounded by the planes through the
+// camera tangent to it along each axis. Returns false when the sphere reaches the near plane
+bool project_sphere(vec4 world_sphere, mat4 view, mat4 proj, float z_near, out vec4 rect) {
+	rect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	// NOTE: View space looks down -z, c.z is the depth in front of the camera
+	vec3 c = (view * vec4(world_sphere.xyz, 1.0f)).xyz * vec3(1.0f, 1.0f, -1.0f);
+	float r = world_sphere.w;
+	if (c.z < r + z_near) {
+		return false;
+	}
+	vec3 cr = c * r;
+	float czr2 = c.z * c.z - r * r;
+	float vx = sqrt(c.x * c.x + czr2);
+	float min_x = (vx * c.x - cr.z) / (vx * c.z + cr.x);
+	float max_x = (vx * c.x + cr.z) / (vx * c.z - cr.x);
+	float vy = sqrt(c.y * c.y + czr2);
+	float min_y = (vy * c.y - cr.z) / (vy * c.z + cr.y);
+	float max_y = (vy * c.y + cr.z) / (vy * c.z - cr.y);
+
+	// The y scale is negative when the projection flips y
+	vec4 ndc = vec4(min_x * proj[0][0], min_y * proj[1][1], max_x * proj[0][0], max_y * proj[1][1]);
+	rect = vec4(min(ndc.xy, ndc.zw), max(ndc.xy, ndc.zw)) * 0.5f + 0.5f;
+	return true;
+}
+
+// Whether the sphere's projected rect can hold a pixel center. Centers sit at k + 0.5, an axis
+// has none inside when both ends of the rect round to the same side of every center. Spheres
+// reaching the near plane always can
+bool sphere_covers_pixel_center(vec4 world_sphere, mat4 view, mat4 proj, float z_near, vec2 render_size) {
+	vec4 rect;
+	if (!project_sphere(world_sphere, view, proj, z_near, rect)) {
+		return true;
+	}
+	vec2 first_center = ceil(rect.xy * render_size - 0.5f);
+	vec2 last_center = floor(rect.zw * render_size - 0.5f);
+	return all(lessThanEqual(first_center, last_center));
+}
+
+// Coarsest level of detail whose error, scaled with the geometry & projected at the bounding
+// sphere's nearest point to the camera, is at most threshold pixels. Full detail when the
+// camera is inside the bounding sphere.
+uint select_lod(geometry geo, vec4 world_sphere, vec3 camera, mat4 proj, float render_height, float threshold) {
+	float distance = length(world_sphere.xyz - camera) - world_sphere.w;
+	if (distance <= 0.0f || geo.radius <= 0.0f) {
+		return 0;
+	}
+	float scale = world_sphere.w / geo.radius;
+	float pixels_per_unit = abs(proj[1][1]) * render_height * 0.5f / distance;
+	uint lod = 0;
+	while (lod + 1 < geo.lod_count && geo.lods[lod + 1].error * scale * pixels_per_unit <= threshold) {
+		lod++;
+	}
+	return lod;
+}
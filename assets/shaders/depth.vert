@@ -0,0 +1,24 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "input_structures.glsl"
+#include "draw_constants.glsl"
+
+// NOTE: Depth prepass vertex shader for materials without alpha testing, reads the material
+// pipeline's draws & only the position stream
+
+layout(set = 1, binding = 0) readonly buffer mat_draws_buffer {
+	draw_command mat_draws[];
+};
+
+// The geometry pass tests EQUAL against this depth, so the position must be computed exactly
+// as the material vertex shaders do
+invariant gl_Position;
+
+void main() {
+	draw_command draw = mat_draws[draw_push.draw_offset + gl_DrawID];
+	vec3 position = unpack_position(gl_VertexIndex, geometries[draw.geo_id]);
+	mat4 model = load_transform(instances[gl_InstanceIndex]);
+
+	gl_Position = frame_data.viewproj * model * vec4(position, 1.0f);
+}
@@ -0,0 +1,36 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "input_structures.glsl"
+#include "draw_constants.glsl"
+
+// NOTE: Depth prepass vertex shader for alpha tested materials
+
+layout(set = 1, binding = 0) readonly buffer mat_draws_buffer {
+	draw_command mat_draws[];
+};
+
+// Material instances all begin with vec4 color factors & the color texture index. Read as words
+// as the instance size differs per material pipeline, see draw_push.inst_stride
+layout(set = 1, binding = 1) readonly buffer mat_inst_buffer {
+	uint mat_inst_words[];
+};
+#define MAT_INST_COLOR_INDEX_WORD 4
+
+layout (location = 0) out vec2 out_uv;
+layout (location = 1) flat out uint out_color_id;
+
+// The geometry pass tests EQUAL against this depth, so the position must be computed exactly
+// as the material vertex shaders do
+invariant gl_Position;
+
+void main() {
+	draw_command draw = mat_draws[draw_push.draw_offset + gl_DrawID];
+	vec3 position = unpack_position(gl_VertexIndex, geometries[draw.geo_id]);
+	mat4 model = load_transform(instances[gl_InstanceIndex]);
+
+	gl_Position = frame_data.viewproj * model * vec4(position, 1.0f);
+
+	out_uv = unpackHalf2x16(attributes[gl_VertexIndex].uv);
+	out_color_id = mat_inst_words[draw.material_id * draw_push.inst_stride + MAT_INST_COLOR_INDEX_WORD];
+}
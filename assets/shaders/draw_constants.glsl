@@ -0,0 +1,9 @@
+// NOTE: Vertex stage push constant of material & shadow pipelines, matches draw_push
+
+// Draw buffers hold the 32 bit index draws followed by the 16 bit index draws,
+// each drawn by its own indirect call. gl_DrawID restarts at 0 for every call.
+layout(push_constant) uniform draw_constants {
+	uint draw_offset;
+	uint inst_stride;	// Material instance size in words, read by the depth prepass
+	uint shadow_cascade;	// Cascade & shadow map layer the shadow pipeline's draws render to
+} draw_push;
@@ -3,9 +3,20 @@
 #extension GL_EXT_nonuniform_qualifier : require
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 
+// NOTE: Must match scene_types.h. Point lights are binned into a grid of froxels, screen tiles split
+// into exponential depth slices between the camera clip distances
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+#define LIGHT_CLUSTER_MAX_LIGHTS 128
+
+// NOTE: Must match vk_types.h
+#define MAX_SHADOW_CASCADES 4
+
 struct point_light {
-	vec4 color;
-	vec4 position;
+	vec4 color;			// rgb, a is the intensity
+	vec4 position;		// xyz, w is the range past which the light is ignored
 };
 
 struct direction_light {
@@ -18,26 +29,57 @@ layout(set = 0, binding = 0) uniform frame_data_block {
 	mat4 view;
 	mat4 proj;
 	mat4 viewproj;
+	// viewproj of the frame the depth pyramid was built from
+	mat4 pyramid_viewproj;
 	vec4 view_pos;
 
 	vec4 ambient_color;
 
-	point_light light;
-
-	// Sun (Directional light) information
-	mat4 sun_viewproj;		// For ShadowMapping
+	// Sun (Directional light) information. Shadow cascades are fitted to slices of the camera
+	// frustum, each rendered to a layer of the shadow map
+	mat4 cascade_viewprojs[MAX_SHADOW_CASCADES];
+	vec4 cascade_splits;	// View depth each cascade ends at
 	direction_light sun;
 
+	// World space frustum planes for culling, normals point inward
+	vec4 frustum_planes[6];
+	vec4 cascade_frustum_planes[MAX_SHADOW_CASCADES][6];	// Box each shadow cascade's casters are culled against
+
 	// Alpha masking info
 	float alpha_cutoff;
 	// Indirect Draw information
-	uint max_draw_count;
+	uint max_draw_count;	// Capacity of each index type's half of a draw buffer
 
 	// TEMP: These will eventually be defined per shadow casting light
 	uint shadow_draws_id;
 	uint shadow_map_id;
+	uint shadow_compare_id;	// Same image as shadow_map_id through a comparison sampler
 	// TEMP: END
 	uint debug_view;
+
+	uint object_count;
+	uint instance_group_count;
+	uint instance_level_count;	// Levels of detail across the instance groups, see scan.glsl
+	uint pipe_count;		// Material pipelines, the shadow draw buffer slot follows them
+	uint cluster_capacity;	// Length of the cluster list, see scan.glsl
+	// Index into counts of this frame's culled object counters (frustum, shadow, occlusion)
+	uint cull_stats_id;
+	uint depth_pyramid_id;
+	// Zero until a depth pyramid has been built
+	uint occlusion_enabled;
+	// Height in pixels of the render image, for screen size culling
+	float render_height;
+	// Largest projected error in pixels of a picked level of detail
+	float lod_threshold;
+	float render_width;
+	// Camera clip distances, the light grid's depth slices span them
+	float z_near;
+	float z_far;
+	uint light_count;
+	uint cascade_count;
+	uint shadow_cascade_mask;	// Cascades rerendered this frame, the others get no shadow draws
+	uint shadow_filter;
+	float sun_angular_radius;	// Radians, sizes the penumbrae of PCSS
 } frame_data;
 
 #define DEBUG_VIEW_TYPE_SHADOW 1
@@ -45,6 +87,14 @@ layout(set = 0, binding = 0) uniform frame_data_block {
 #define DEBUG_VIEW_TYPE_NORMAL 3
 #define DEBUG_VIEW_TYPE_MAX 4
 
+#define SHADOW_FILTER_PCF_3X3 0
+#define SHADOW_FILTER_PCF_5X5 1
+#define SHADOW_FILTER_PCF_7X7 2
+#define SHADOW_FILTER_PCSS 3
+
+// Per draw buffer slot, the 32 bit index draw count followed by the 16 bit index draw count.
+// Culling stats follow the last slot
+#define DRAW_INDEX_TYPE_COUNT 2
 layout(set = 0, binding = 1, std430) buffer draw_counts {
 	uint counts[];
 };
@@ -54,10 +104,10 @@ struct draw_command {
 	uint instance_count;
 	uint first_index;
 	int vertex_offset;
-	uint first_instance;
+	uint first_instance;	// Index into instances[] of the draw's first instance
 
 	uint material_id;
-	uint transform_id;
+	uint geo_id;
 };
 layout(buffer_reference, std430) writeonly buffer draw_buffer {
 	draw_command draws[];
@@ -77,36 +127,203 @@ struct object {
 	uint mat_id;		// Material Instance
 	uint geo_id;		// Geometry
 	uint transform_id;	// Transform
+	uint group_id;		// Instance group, INVALID_ID when the object is drawn alone
 };
 layout(set = 0, binding = 3, std430) readonly buffer object_buffer {
 	object objects[];
 };
 
-struct geometry {
+#define GEOMETRY_MAX_LODS 4
+
+#define INDEX_TYPE_U32 0
+#define INDEX_TYPE_U16 1
+
+struct geometry_lod {
 	uint start_index;
 	uint index_count;
+	uint meshlet_offset;
+	uint meshlet_count;
+	float error;		// Geometry local space distance from the full detail surface
+};
+
+struct geometry {
+	uint start_index;	// Full detail
+	uint index_count;
 	int vertex_offset;
 	float radius;
 	vec4 origin;
 	vec4 extent;
+	uint lod_count;
+	uint color_offset;	// First vertex color in colors[], INVALID_ID when the geometry has none
+	uint index_type;	// Index buffer the index ranges are in
+	geometry_lod lods[GEOMETRY_MAX_LODS];	// Full detail first, increasing error
 };
 layout(set = 0, binding = 4, std430) readonly buffer geometry_buffer {
 	geometry geometries[];
 };
 
-struct vertex {
-    vec3 position;
-    float uv_x;
-    vec3 normal;
-    float uv_y;
-    vec4 color;
+// Quantized vertex position, see unpack_position. Depth only passes read nothing else
+struct packed_position {
+	uint xy;			// 2x unorm16 across the geometry's bounding box
+	uint z;				// unorm16, upper half unused
 };
-layout(set = 0, binding = 5, std430) readonly buffer vertex_buffer {
-	vertex vertices[];
+layout(set = 0, binding = 5, std430) readonly buffer position_buffer {
+	packed_position positions[];
 };
 
+// Rows of an affine model matrix, the bottom row is always (0, 0, 0, 1). See load_transform
+struct affine_transform {
+	vec4 rows[3];
+};
 layout(set = 0, binding = 6, std430) readonly buffer transform_buffer {
-	mat4 transforms[];
+	affine_transform transforms[];
+};
+
+// Objects rejected by the early occlusion test, retested by the late draw generation pass
+layout(set = 0, binding = 7, std430) buffer occlusion_buffer {
+	uint occluded[];
+};
+
+// Run of a geometry's triangles that is culled as a unit, bounds in geometry local space
+struct meshlet {
+	vec4 sphere;		// center, radius
+	vec4 cone;			// axis, cutoff
+	uint start_index;
+	uint index_count;
+};
+layout(set = 0, binding = 8, std430) readonly buffer meshlet_buffer {
+	meshlet meshlets[];
+};
+
+// Meshlets of the objects that passed object culling, filled by draw generation & consumed
+// by cluster culling. The header doubles as the indirect dispatch of cluster culling
+layout(set = 0, binding = 9, std430) buffer cluster_buffer {
+	uint cluster_groups_x;
+	uint cluster_groups_y;
+	uint cluster_groups_z;
+	uint cluster_count;
+	uvec2 clusters[];	// object index, meshlet index
+};
+
+// RGBA8 vertex colors of the geometries that have them, see geometry.color_offset
+layout(set = 0, binding = 10, std430) readonly buffer color_buffer {
+	uint colors[];
 };
 
-layout(set = 0, binding = 7) uniform sampler2D textures[];
\ No newline at end of file
+// Quantized vertex attributes, parallel to positions[], see unpack_vertex
+struct packed_attributes {
+	uint normal;		// Octahedral, 2x snorm16
+	uint uv;			// 2x half float
+};
+layout(set = 0, binding = 11, std430) readonly buffer attribute_buffer {
+	packed_attributes attributes[];
+};
+
+// Objects sharing a pipeline, material & geometry, stored contiguously in objects[]. Drawn with
+// one instanced draw per level of detail instead of per meshlet draws
+struct instance_group {
+	uint pipe_id;
+	uint mat_id;
+	uint geo_id;
+	uint first_object;
+	uint object_count;
+	uint first_level;	// First of its levels of detail among those of every group, see pipe_range
+};
+layout(set = 0, binding = 12, std430) readonly buffer instance_group_buffer {
+	instance_group groups[];
+};
+
+// Transform index per drawn instance, read at gl_InstanceIndex. The first object_count entries
+// are the objects' own transforms for single instance draws, followed by the visible instance
+// list of every group & level of detail, see instance_list_offset in scan.glsl
+layout(set = 0, binding = 13, std430) buffer instance_buffer {
+	uint instances[];
+};
+
+// Objects of a material pipeline, contiguous in objects[] as they are sorted by pipeline, & the
+// levels of detail of its instance groups. Each index type's draws of the pipeline begin with
+// an instanced draw per level with visible instances, the cluster draws follow in cluster list order
+struct pipe_range {
+	uint first_object;
+	uint object_end;
+	uint first_level;
+	uint level_end;
+};
+layout(set = 0, binding = 14, std430) readonly buffer pipe_range_buffer {
+	pipe_range pipe_ranges[];
+};
+
+// Prefix sums of draw generation, see scan.glsl
+layout(set = 0, binding = 15, std430) buffer scan_buffer {
+	uvec2 scan[];
+};
+
+// Every point light of the scene, see lights.glsl for the froxels they are binned into
+layout(set = 0, binding = 16, std430) readonly buffer light_buffer {
+	point_light lights[];
+};
+
+layout(set = 0, binding = 17, std430) buffer light_cluster_buffer {
+	uint light_counts[LIGHT_CLUSTER_COUNT];
+	uint light_indices[];	// LIGHT_CLUSTER_MAX_LIGHTS per froxel
+};
+
+layout(set = 0, binding = 18) uniform sampler2D textures[];
+// Aliases textures[] for the layered images, like the shadow cascades
+layout(set = 0, binding = 18) uniform sampler2DArray texture_arrays[];
+layout(set = 0, binding = 18) uniform sampler2DArrayShadow shadow_arrays[];
+
+#define INVALID_ID 0xFFFFFFFF
+
+struct vertex {
+	vec3 position;
+	float uv_x;
+	vec3 normal;
+	float uv_y;
+	vec4 color;
+};
+
+vec3 oct_decode(vec2 e) {
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += (n.x >= 0.0f) ? -t : t;
+	n.y += (n.y >= 0.0f) ? -t : t;
+	return normalize(n);
+}
+
+mat4 load_transform(uint transform_id) {
+	affine_transform t = transforms[transform_id];
+	return transpose(mat4(t.rows[0], t.rows[1], t.rows[2], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+// Inverse transpose of the model's upper 3x3 up to a positive scale, normals must be
+// normalized after. The cofactors are the inverse transpose times the determinant, whose
+// sign is flipped back for mirroring transforms.
+mat3 normal_matrix(mat4 model) {
+	vec3 c0 = model[0].xyz;
+	vec3 c1 = model[1].xyz;
+	vec3 c2 = model[2].xyz;
+	mat3 cofactors = mat3(cross(c1, c2), cross(c2, c0), cross(c0, c1));
+	return (dot(c0, cofactors[0]) < 0.0f) ? -cofactors : cofactors;
+}
+
+// Decodes positions[index], which belongs to geo
+vec3 unpack_position(uint index, geometry geo) {
+	packed_position p = positions[index];
+	vec3 position = vec3(unpackUnorm2x16(p.xy), unpackUnorm2x16(p.z).x);
+	return geo.origin.xyz + geo.extent.xyz * (position * 2.0f - 1.0f);
+}
+
+// Decodes every stream of the vertex at index, which belongs to geo
+vertex unpack_vertex(uint index, geometry geo) {
+	packed_attributes p = attributes[index];
+	vertex v;
+	v.position = unpack_position(index, geo);
+	v.normal = oct_decode(unpackSnorm2x16(p.normal));
+	vec2 uv = unpackHalf2x16(p.uv);
+	v.uv_x = uv.x;
+	v.uv_y = uv.y;
+	v.color = (geo.color_offset == INVALID_ID) ? vec4(1.0f) :
+		unpackUnorm4x8(colors[geo.color_offset + index - uint(geo.vertex_offset)]);
+	return v;
+}
@@ -0,0 +1,28 @@
+// Froxel lookups of clustered lighting, expects input_structures.glsl to be included first
+
+// View space distance down -z at which a depth slice of the light grid begins
+float light_slice_depth(uint slice) {
+	return frame_data.z_near * pow(frame_data.z_far / frame_data.z_near, float(slice) / float(LIGHT_GRID_Z));
+}
+
+// Froxel containing a fragment, from its window coordinates & world space position
+uint light_cluster(vec2 frag_coord, vec3 position) {
+	float depth = -(frame_data.view * vec4(position, 1.0f)).z;
+	float slice = log(max(depth, frame_data.z_near) / frame_data.z_near) * float(LIGHT_GRID_Z) / log(frame_data.z_far / frame_data.z_near);
+	vec2 tile = frag_coord * vec2(LIGHT_GRID_X, LIGHT_GRID_Y) / vec2(frame_data.render_width, frame_data.render_height);
+	uvec3 cluster = min(uvec3(uvec2(tile), uint(slice)), uvec3(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1, LIGHT_GRID_Z - 1));
+	return (cluster.z * LIGHT_GRID_Y + cluster.y) * LIGHT_GRID_X + cluster.x;
+}
+
+// Index into lights[] of the i'th light binned into cluster
+uint cluster_light(uint cluster, uint i) {
+	return light_indices[cluster * LIGHT_CLUSTER_MAX_LIGHTS + i];
+}
+
+// Inverse square falloff, windowed to reach zero at the light's range so lights past it can be culled
+float light_attenuation(float dist, float range) {
+	float ratio = dist / range;
+	float ratio2 = ratio * ratio;
+	float window = clamp(1.0f - ratio2 * ratio2, 0.0f, 1.0f);
+	return window * window / max(dist * dist, 0.0001f);
+}
@@ -3,6 +3,8 @@
 
 #include "input_structures.glsl"
 #include "common.glsl"
+#include "lights.glsl"
+#include "shadows.glsl"
 
 // NOTE: Much of this is from learnopengl.com's information & code about PBR
 
@@ -23,14 +25,13 @@ layout(set = 1, binding = 1) readonly buffer mat_inst_buffer {
 };
 
 layout (location = 0) in vec3 in_position;
-layout (location = 1) in vec4 in_sun_position;
-layout (location = 2) in vec3 in_normal;
-layout (location = 3) in vec3 in_color;
-layout (location = 4) in vec2 in_uv;
-layout (location = 5) flat in uint in_mat_id;
-layout (location = 6) flat in uint in_color_id;
-layout (location = 7) flat in uint in_mr_id;
-layout (location = 8) flat in uint in_normal_id;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec3 in_color;
+layout (location = 3) in vec2 in_uv;
+layout (location = 4) flat in uint in_mat_id;
+layout (location = 5) flat in uint in_color_id;
+layout (location = 6) flat in uint in_mr_id;
+layout (location = 7) flat in uint in_normal_id;
 
 layout(location = 0) out vec4 out_frag_color;
 
@@ -93,25 +94,8 @@ void main() {
 
     float NdotLs = max(dot(N, Ls), 0.0);
 
-    // TEMP: Create calculate_shadow function
-    vec3 shadow_coords = in_sun_position.xyz;
-    vec2 shadow_uv = shadow_coords.xy * 0.5f + 0.5f;
-    float min_bias_factor = 0.002f;
-    float max_bias_factor = 0.005f;
-    float bias = max(max_bias_factor * (1.0f - NdotLs), min_bias_factor);
-
-    float shadow = 0.f;
-    vec2 texel_size = 1.f / textureSize(textures[frame_data.shadow_map_id], 0);
-    for (int x = -1; x <= 1; ++x) {
-        for(int y = -1; y <= 1; ++y) {
-            float map_depth = texture(textures[frame_data.shadow_map_id], shadow_uv + vec2(x, y) * texel_size).x;
-            shadow += (shadow_coords.z + bias < map_depth) ? (1.f / 9.f) : 0.f;
-        }
-    }
-
-    // float closest_depth = texture(textures[frame_data.shadow_map_id], shadow_uv).x;
-    // float current_depth = shadow_coords.z;
-    // float shadow = (current_depth + bias < closest_depth) ? 1.0f : 0.0f;
+    vec3 shadow_coords;
+    float shadow = 1.0f - sun_shadow(in_position, NdotLs, shadow_coords);
 
     // https://www.khronos.org/opengl/wiki/Sampler_(GLSL)#Non-uniform_flow_control
     // Alpha discard after all texture sampling has been done to preserve uniform control flow
@@ -122,28 +106,34 @@ void main() {
     vec3 Los = (1.f - shadow) * (kDs * albedo * INV_PI + s_specular) * s_radiance * NdotLs;
     // NOTE: END
 
-    // NOTE: Point light, singular for now
-    vec3 L = normalize(frame_data.light.position.xyz - in_position);
-    vec3 H = normalize(V + L);
-    float dist = length(frame_data.light.position.xyz - in_position);
-    float attenuation = 1.0 / (dist * dist);
-    vec3 radiance = frame_data.light.color.rgb * frame_data.light.color.a * attenuation;
-
-    // Cook-Torrance BRDF
-    float NDF = distribution_ggx(N, H, roughness);
-    float G = geometry_smith(N, V, L, roughness);
-    vec3 F = fresnel_schlick(max(dot(H, V), 0.0), F0);
-
-    vec3 numerator = NDF * G * F;
-    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
-    vec3 specular = numerator / denominator;
-
-    vec3 kS = F;
-    vec3 kD = vec3(1.0) - kS;
-    kD *= 1.0 - metallic;
-
-    float NdotL = max(dot(N, L), 0.0);
-    vec3 Lo = (kD * albedo * INV_PI + specular) * radiance * NdotL;
+    // NOTE: Point lights binned into this fragment's froxel
+    vec3 Lo = vec3(0.0);
+    uint cluster = light_cluster(gl_FragCoord.xy, in_position);
+    uint light_count = light_counts[cluster];
+    for (uint i = 0; i < light_count; ++i) {
+        point_light light = lights[cluster_light(cluster, i)];
+        vec3 L = normalize(light.position.xyz - in_position);
+        vec3 H = normalize(V + L);
+        float dist = length(light.position.xyz - in_position);
+        float attenuation = light_attenuation(dist, light.position.w);
+        vec3 radiance = light.color.rgb * light.color.a * attenuation;
+
+        // Cook-Torrance BRDF
+        float NDF = distribution_ggx(N, H, roughness);
+        float G = geometry_smith(N, V, L, roughness);
+        vec3 F = fresnel_schlick(max(dot(H, V), 0.0), F0);
+
+        vec3 numerator = NDF * G * F;
+        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
+        vec3 specular = numerator / denominator;
+
+        vec3 kS = F;
+        vec3 kD = vec3(1.0) - kS;
+        kD *= 1.0 - metallic;
+
+        float NdotL = max(dot(N, L), 0.0);
+        Lo += (kD * albedo * INV_PI + specular) * radiance * NdotL;
+    }
     // NOTE: END
 
     vec3 ambient = vec3(0.03) * albedo * frame_data.ambient_color.a;
@@ -2,6 +2,7 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "input_structures.glsl"
+#include "draw_constants.glsl"
 
 layout(set = 1, binding = 0) readonly buffer pbr_draws_buffer {
     draw_command pbr_draws[];
@@ -20,28 +21,28 @@ layout(set = 1, binding = 1) readonly buffer mat_inst_buffer {
 };
 
 layout (location = 0) out vec3 out_position;
-layout (location = 1) out vec4 out_sun_position;
-layout (location = 2) out vec3 out_normal;
-layout (location = 3) out vec3 out_color;
-layout (location = 4) out vec2 out_uv;
-layout (location = 5) flat out uint out_mat_id;
-layout (location = 6) flat out uint out_color_id;
-layout (location = 7) flat out uint out_mr_id;
-layout (location = 8) flat out uint out_normal_id;
+layout (location = 1) out vec3 out_normal;
+layout (location = 2) out vec3 out_color;
+layout (location = 3) out vec2 out_uv;
+layout (location = 4) flat out uint out_mat_id;
+layout (location = 5) flat out uint out_color_id;
+layout (location = 6) flat out uint out_mr_id;
+layout (location = 7) flat out uint out_normal_id;
+
+// Bit identical to the depth prepass position, the geometry pass tests EQUAL against it
+invariant gl_Position;
 
 void main() {
-    draw_command draw = pbr_draws[gl_DrawID];
-    vertex v = vertices[gl_VertexIndex];
-    mat4 model = transforms[draw.transform_id];
+    draw_command draw = pbr_draws[draw_push.draw_offset + gl_DrawID];
+    vertex v = unpack_vertex(gl_VertexIndex, geometries[draw.geo_id]);
+    mat4 model = load_transform(instances[gl_InstanceIndex]);
 
     gl_Position = frame_data.viewproj * model * vec4(v.position, 1.0f);
 
     vec4 world_pos = model * vec4(v.position, 1.0f);
     out_position = world_pos.xyz;
-    out_sun_position = frame_data.sun_viewproj * world_pos;
 
-    // TODO: Compute the normal matrix on the CPU and not GPU
-    out_normal = (transpose(inverse(model)) * vec4(v.normal, 0.0f)).xyz;
+    out_normal = normal_matrix(model) * v.normal;
 
     out_color = v.color.rgb * mat_insts[nonuniformEXT(draw.material_id)].color_factors.rgb;
     out_uv.x = v.uv_x;
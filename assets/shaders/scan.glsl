@@ -0,0 +1,107 @@
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+
+// Prefix sums for deterministic draw compaction. A visibility pass writes a count per element,
+// the exclusive prefix sum of the counts is each element's output offset, so the output keeps
+// element order without atomics. Elements are scanned in blocks of SCAN_BLOCK_SIZE by the
+// visibility pass or prefix_sum.comp, the block totals are then scanned by prefix_sum.comp
+#define SCAN_BLOCK_SIZE 256
+
+uint scan_block_count(uint count) {
+	return (count + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE;
+}
+
+// Regions of scan[]. The regions over the objects come first, each followed by its block totals:
+// the cluster count of every object with the meshlet offset of its level of detail carried in y,
+// the visible instances of every level of detail, two levels per region, & the shadow draws of
+// every object by index type, a region per cascade. The visible draws of every cluster list
+// entry by index type & the instanced draws of every instance group level of detail by index
+// type follow, each with its block totals. Regions hold an extra element past the last for the total
+#define OBJECT_SCAN_CLUSTERS 0
+#define OBJECT_SCAN_INSTANCES 1
+#define OBJECT_SCAN_SHADOW (OBJECT_SCAN_INSTANCES + GEOMETRY_MAX_LODS / 2)
+#define OBJECT_SCAN_REGION_COUNT (OBJECT_SCAN_SHADOW + MAX_SHADOW_CASCADES)
+
+uint object_region_offset(uint region) {
+	uint region_size = frame_data.object_count + 1 + scan_block_count(frame_data.object_count + 1);
+	return region * region_size;
+}
+uint object_region_sums(uint region) {
+	return object_region_offset(region) + frame_data.object_count + 1;
+}
+uint object_scan_offset() {
+	return object_region_offset(OBJECT_SCAN_CLUSTERS);
+}
+uint object_sums_offset() {
+	return object_region_sums(OBJECT_SCAN_CLUSTERS);
+}
+uint cluster_scan_offset() {
+	return object_region_offset(OBJECT_SCAN_REGION_COUNT);
+}
+uint cluster_sums_offset() {
+	return cluster_scan_offset() + frame_data.cluster_capacity + 1;
+}
+uint instance_level_scan_offset() {
+	return cluster_sums_offset() + scan_block_count(frame_data.cluster_capacity + 1);
+}
+uint instance_level_sums_offset() {
+	return instance_level_scan_offset() + frame_data.instance_level_count + 1;
+}
+
+// Exclusive prefix sum of element i of a region once its block totals are scanned
+uvec2 scanned(uint offset, uint sums_offset, uint i) {
+	return scan[offset + i] + scan[sums_offset + i / SCAN_BLOCK_SIZE];
+}
+
+shared uvec2 scan_subgroup_totals[SCAN_BLOCK_SIZE];
+
+// Exclusive prefix sum of v across a workgroup of SCAN_BLOCK_SIZE invocations, total is the sum
+// of the workgroup. Every invocation of the workgroup must call it
+uvec2 workgroup_exclusive_scan(uvec2 v, out uvec2 total) {
+	uvec2 subgroup_prefix = subgroupExclusiveAdd(v);
+	uvec2 subgroup_total = subgroupAdd(v);
+	if (subgroupElect()) {
+		scan_subgroup_totals[gl_SubgroupID] = subgroup_total;
+	}
+	barrier();
+	uvec2 prefix = subgroup_prefix;
+	total = uvec2(0);
+	for (uint i = 0; i < gl_NumSubgroups; ++i) {
+		uvec2 subgroup_sum = scan_subgroup_totals[i];
+		prefix += (i < gl_SubgroupID) ? subgroup_sum : uvec2(0);
+		total += subgroup_sum;
+	}
+	// The totals are rewritten by the next call
+	barrier();
+	return prefix;
+}
+
+// Exclusive prefix sum of an object region's element i once its block totals are scanned
+uvec2 object_scanned(uint region, uint i) {
+	return scanned(object_region_offset(region), object_region_sums(region), i);
+}
+
+// Visible instances of a level of detail among the objects before object i
+uint instance_prefix(uint lod, uint i) {
+	return object_scanned(OBJECT_SCAN_INSTANCES + lod / 2, i)[lod % 2];
+}
+
+uint instance_count(instance_group group, uint lod) {
+	return instance_prefix(lod, group.first_object + group.object_count) - instance_prefix(lod, group.first_object);
+}
+
+// First entry in instances[] of the visible instance list of a group's level of detail. A group
+// has at most object_count visible instances, its lists follow each other in level order
+uint instance_list_offset(instance_group group, uint lod) {
+	uint offset = frame_data.object_count + group.first_object;
+	for (uint i = 0; i < lod; ++i) {
+		offset += instance_count(group, i);
+	}
+	return offset;
+}
+
+// Instanced draws of a pipeline by index type, levels of detail without visible instances have none
+uvec2 instance_draw_counts(pipe_range range) {
+	return scanned(instance_level_scan_offset(), instance_level_sums_offset(), range.level_end) -
+		scanned(instance_level_scan_offset(), instance_level_sums_offset(), range.first_level);
+}
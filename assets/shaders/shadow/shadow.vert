@@ -1,15 +1,19 @@
 #version 460
 #extension GL_GOOGLE_include_directive : require
+#extension GL_ARB_shader_viewport_layer_array : require
 
 #include "../input_structures.glsl"
+#include "../draw_constants.glsl"
 
 // NOTE: This is the shadow map vertex shader for non alpha mask shader
+// Each indirect call draws one cascade, routed to its layer of the shadow map
 
 void main() {
     read_draw_buffer shadow_draws = read_draw_buffer(draw_buffers[frame_data.shadow_draws_id]);
-    draw_command draw = shadow_draws.draws[gl_DrawID];
-    vertex v = vertices[gl_VertexIndex];
-    mat4 model = transforms[draw.transform_id];
+    draw_command draw = shadow_draws.draws[draw_push.draw_offset + gl_DrawID];
+    vec3 position = unpack_position(gl_VertexIndex, geometries[draw.geo_id]);
+    mat4 model = load_transform(instances[gl_InstanceIndex]);
 
-    gl_Position = frame_data.sun_viewproj * model * vec4(v.position, 1.0f);
+    gl_Position = frame_data.cascade_viewprojs[draw_push.shadow_cascade] * model * vec4(position, 1.0f);
+    gl_Layer = int(draw_push.shadow_cascade);
 }
\ No newline at end of file
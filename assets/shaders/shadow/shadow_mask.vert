@@ -1,18 +1,21 @@
 #version 460
 #extension GL_GOOGLE_include_directive : require
+#extension GL_ARB_shader_viewport_layer_array : require
 
 #include "../input_structures.glsl"
+#include "../draw_constants.glsl"
 
 layout (location = 0) out vec2 out_uv;
 layout (location = 1) flat out uint out_color_id;
 
 void main() {
     read_draw_buffer shadow_draws = read_draw_buffer(draw_buffers[frame_data.shadow_draws_id]);
-    draw_command draw = shadow_draws.draws[gl_DrawID];
-    vertex v = vertices[gl_VertexIndex];
-    mat4 model = transforms[draw.transform_id];
+    draw_command draw = shadow_draws.draws[draw_push.draw_offset + gl_DrawID];
+    vertex v = unpack_vertex(gl_VertexIndex, geometries[draw.geo_id]);
+    mat4 model = load_transform(instances[gl_InstanceIndex]);
 
-    gl_Position = frame_data.sun_viewproj * model * vec4(v.position, 1.0f);
+    gl_Position = frame_data.cascade_viewprojs[draw_push.shadow_cascade] * model * vec4(v.position, 1.0f);
+    gl_Layer = int(draw_push.shadow_cascade);
 
     out_uv = vec2(v.uv_x, v.uv_y);
     // out_color_id = draw.color_id;
@@ -0,0 +1,116 @@
+// Filtering of the sun's shadow cascades, expects input_structures.glsl to be included first
+
+// Depth bias in texels of the cascade, the slope term grows with the tangent of the light's angle
+#define SHADOW_BIAS_TEXELS 1.0f
+#define SHADOW_BIAS_SLOPE_TEXELS 2.0f
+#define SHADOW_BIAS_MAX_SLOPE 8.0f
+// PCSS blocker search region & kernel radius limits, in texels
+#define PCSS_SEARCH_MAX_TEXELS 16.0f
+#define PCSS_MAX_KERNEL_RADIUS 4
+
+// World units per texel & per unit of depth of a cascade, from the scale of its orthographic projection
+vec2 cascade_world_scale(uint cascade, float resolution) {
+	mat4 m = frame_data.cascade_viewprojs[cascade];
+	float width = 2.0f / length(vec3(m[0][0], m[1][0], m[2][0]));
+	float depth = 1.0f / length(vec3(m[0][2], m[1][2], m[2][2]));
+	return vec2(width / resolution, depth);
+}
+
+// Lit fraction of the (2 * radius + 1)^2 texel box around uv. Bilinearly weighted so the kernel
+// slides smoothly between texels: the box's first row & column are weighted by 1 - fract, the
+// row & column past it by fract. Each comparison gather covers a 2x2 block, (radius + 1)^2 gathers
+float shadow_pcf(uint cascade, vec2 uv, float ref, int radius) {
+	vec2 size = vec2(textureSize(shadow_arrays[frame_data.shadow_compare_id], 0).xy);
+	vec2 tc = uv * size - 0.5f;
+	vec2 base = floor(tc);
+	vec2 f = tc - base;
+
+	float lit = 0.0f;
+	for (int y = -radius; y <= radius; y += 2) {
+		for (int x = -radius; x <= radius; x += 2) {
+			// Texels (x, y) to (x + 1, y + 1) from base, gathered at their shared corner
+			vec2 block_uv = (base + vec2(x, y) + 1.0f) / size;
+			vec4 g = textureGather(shadow_arrays[frame_data.shadow_compare_id], vec3(block_uv, float(cascade)), ref);
+			vec2 w0 = vec2((x == -radius) ? 1.0f - f.x : 1.0f, (y == -radius) ? 1.0f - f.y : 1.0f);
+			vec2 w1 = vec2((x == radius) ? f.x : 1.0f, (y == radius) ? f.y : 1.0f);
+			// Gather order: (x0, y1), (x1, y1), (x1, y0), (x0, y0)
+			lit += dot(g, vec4(w0.x * w1.y, w1.x * w1.y, w1.x * w0.y, w0.x * w0.y));
+		}
+	}
+	float width = float(2 * radius + 1);
+	return lit / (width * width);
+}
+
+// Percentage closer soft shadows. Blockers are searched in the region the sun's disk covers from the
+// receiver, the PCF kernel then widens with their average distance to the receiver
+float shadow_pcss(uint cascade, vec2 uv, float ref) {
+	vec2 size = vec2(textureSize(texture_arrays[frame_data.shadow_map_id], 0).xy);
+	vec2 scale = cascade_world_scale(cascade, size.x);
+	float tan_sun = tan(frame_data.sun_angular_radius);
+
+	// NOTE: Reverse z, the sun side of the cascade is at depth 1 & blockers are deeper than ref
+	float search_texels = clamp((1.0f - ref) * scale.y * tan_sun / scale.x, 1.0f, PCSS_SEARCH_MAX_TEXELS);
+	float blocker_count = 0.0f;
+	float blocker_depth = 0.0f;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			vec2 sample_uv = uv + vec2(x, y) * search_texels / size;
+			vec4 d = textureGather(texture_arrays[frame_data.shadow_map_id], vec3(sample_uv, float(cascade)), 0);
+			vec4 blocker = vec4(greaterThan(d, vec4(ref)));
+			blocker_count += dot(blocker, vec4(1.0f));
+			blocker_depth += dot(d, blocker);
+		}
+	}
+	if (blocker_count == 0.0f) {
+		return 1.0f;
+	}
+	blocker_depth /= blocker_count;
+
+	float penumbra_texels = (blocker_depth - ref) * scale.y * tan_sun / scale.x;
+	int radius = clamp(int(ceil(penumbra_texels)), 1, PCSS_MAX_KERNEL_RADIUS);
+	return shadow_pcf(cascade, uv, ref, radius);
+}
+
+// Fraction of the sun's light reaching a world space position, 1 past the last cascade.
+// shadow_coords are the position's coordinates in the cascade used, for debug views
+float sun_shadow(vec3 position, float NdotL, out vec3 shadow_coords) {
+	// First cascade whose slice of the view frustum holds the fragment
+	float view_depth = -(frame_data.view * vec4(position, 1.0f)).z;
+	uint cascade = 0;
+	while (cascade < frame_data.cascade_count && view_depth > frame_data.cascade_splits[cascade]) {
+		cascade++;
+	}
+
+	// NOTE: Far cascades are rerendered on a staggered schedule & can lag behind the camera,
+	// a fragment outside its cascade's layer falls through to the next one
+	shadow_coords = vec3(0.0f);
+	for (; cascade < frame_data.cascade_count; ++cascade) {
+		shadow_coords = (frame_data.cascade_viewprojs[cascade] * vec4(position, 1.0f)).xyz;
+		if (all(greaterThanEqual(shadow_coords, vec3(-1.0f, -1.0f, 0.0f))) && all(lessThanEqual(shadow_coords, vec3(1.0f)))) {
+			break;
+		}
+	}
+	if (cascade >= frame_data.cascade_count) {
+		return 1.0f;
+	}
+
+	// Bias in world units scaled to the cascade's texels, converted to its depth
+	vec2 size = vec2(textureSize(shadow_arrays[frame_data.shadow_compare_id], 0).xy);
+	vec2 scale = cascade_world_scale(cascade, size.x);
+	float cos_theta = max(NdotL, 0.001f);
+	float tan_theta = min(sqrt(1.0f - cos_theta * cos_theta) / cos_theta, SHADOW_BIAS_MAX_SLOPE);
+	float bias = scale.x * (SHADOW_BIAS_TEXELS + SHADOW_BIAS_SLOPE_TEXELS * tan_theta) / scale.y;
+
+	vec2 uv = shadow_coords.xy * 0.5f + 0.5f;
+	float ref = shadow_coords.z + bias;
+	switch (frame_data.shadow_filter) {
+		case SHADOW_FILTER_PCF_3X3:
+			return shadow_pcf(cascade, uv, ref, 1);
+		case SHADOW_FILTER_PCF_5X5:
+			return shadow_pcf(cascade, uv, ref, 2);
+		case SHADOW_FILTER_PCF_7X7:
+			return shadow_pcf(cascade, uv, ref, 3);
+		default:
+			return shadow_pcss(cascade, uv, ref);
+	}
+}
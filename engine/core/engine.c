@@ -17,11 +17,16 @@
 
 #include "application_types.h"
 
+// Seconds between gpu memory usage log lines
+#define GPU_MEMORY_LOG_INTERVAL 10.0
+
 // TODO: Add application name to config
 typedef struct engine_t {
     b8 is_running;
     b8 is_minimized;
     clock frame;
+    // Seconds since gpu memory usage was last logged
+    f64 gpu_memory_log_time;
 
     // HACK:TEMP: Proper scene management
     scene* main_scene;
@@ -57,6 +62,7 @@ b8 engine_initialize(engine_config engine_details, application_config app_detail
     engine->is_minimized = false;
     engine->frame.start = 0;
     engine->frame.elapsed = 0;
+    engine->gpu_memory_log_time = 0;
 
     if (!logger_initialize()) {
         ETFATAL("Unable to initialize logger.");
@@ -108,7 +114,12 @@ b8 engine_initialize(engine_config engine_details, application_config app_detail
         .resolution_width = engine_details.width,
         .resolution_height = engine_details.height,
         .renderer_state = engine->renderer_state,
-        .import_payload = &test_payload};
+        .import_payload = &test_payload,
+        .depth_prepass = false,
+        .shadow_cascade_count = 4,
+        .shadow_distance = 100.0f,
+        .shadow_receiver_culling = true,
+        .shadow_filter = SHADOW_FILTER_PCF_5X5};
     if (!scene_init(&engine->main_scene, scene_config)) {
         ETFATAL("Unable to initialize scene from payload.");
         return false;
@@ -151,9 +162,15 @@ b8 engine_run(void) {
         if (!engine->is_minimized) {
             clock_time(&engine->frame);
             f64 dt = engine->frame.elapsed;
-            printf("Frame time: %.8llfms | x: %lf y: %lf z: %lf\r", dt * 1000, engine->main_scene->cam.position.x, engine->main_scene->cam.position.y, engine->main_scene->cam.position.z);
+            printf("Frame time: %.8llfms | geometry: %.3fms | x: %lf y: %lf z: %lf | culled: %u shadow culled: %u occluded: %u clusters culled: %u\r", dt * 1000, engine->main_scene->geometry_pass_ms, engine->main_scene->cam.position.x, engine->main_scene->cam.position.y, engine->main_scene->cam.position.z, engine->main_scene->culled_objects, engine->main_scene->culled_shadow_objects, engine->main_scene->occluded_objects, engine->main_scene->culled_clusters);
             clock_start(&engine->frame);
 
+            engine->gpu_memory_log_time += dt;
+            if (engine->gpu_memory_log_time >= GPU_MEMORY_LOG_INTERVAL) {
+                renderer_log_gpu_memory(engine->renderer_state);
+                engine->gpu_memory_log_time = 0;
+            }
+
             scene_update(engine->main_scene, dt);
             engine->app_update(engine->app, dt);
             
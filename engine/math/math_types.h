@@ -20,6 +20,20 @@ typedef struct vertex {
     v4s color;
 } vertex;
 
+// GPU vertex position, packed with position_pack. Depth only passes read nothing else, so
+// positions are a stream of their own
+typedef struct packed_position {
+    u16 position[3];        // UNORM16 across the geometry's bounding box
+    u16 padding;
+} packed_position;
+
+// GPU vertex attributes, packed with attributes_pack. Colors are a separate stream as most
+// geometry has none
+typedef struct packed_attributes {
+    u32 normal;             // Octahedral, 2x SNORM16
+    u32 uv;                 // 2x half float
+} packed_attributes;
+
 typedef struct vertex2d {
     v2s position;
     v2s uv;
@@ -13,4 +13,9 @@ typedef struct renderer_config {
 
 b8 renderer_initialize(renderer_state** out_state, renderer_config config);
 
-void renderer_shutdown(renderer_state* state);
\ No newline at end of file
+void renderer_shutdown(renderer_state* state);
+
+// Device memory usage by category & per heap budgets (VK_EXT_memory_budget when available)
+void renderer_get_gpu_memory_stats(renderer_state* state, gpu_memory_stats* out_stats);
+
+void renderer_log_gpu_memory(renderer_state* state);
\ No newline at end of file
@@ -2,4 +2,39 @@
 #include "defines.h"
 
 typedef struct renderer_state renderer_state;
-typedef struct swapchain swapchain;
\ No newline at end of file
+typedef struct swapchain swapchain;
+
+// NOTE: Category of a gpu allocation, the device memory equivalent of memory_tag
+typedef enum gpu_memory_tag {
+    GPU_MEMORY_TAG_RENDER_TARGET,
+    GPU_MEMORY_TAG_TEXTURE,
+    GPU_MEMORY_TAG_GEOMETRY,
+    GPU_MEMORY_TAG_SCENE,
+    GPU_MEMORY_TAG_DRAWS,
+    GPU_MEMORY_TAG_MATERIAL,
+    GPU_MEMORY_TAG_STAGING,
+    GPU_MEMORY_TAG_MAX
+} gpu_memory_tag;
+
+#define GPU_MEMORY_MAX_HEAPS 16
+
+typedef struct gpu_memory_heap_stats {
+    u64 size;
+    // Bytes allocated from the heap by the renderer (blocks & dedicated allocations)
+    u64 allocated;
+    // Budget & usage across the whole process as reported by VK_EXT_memory_budget.
+    // Without the extension budget is the heap size & usage is allocated
+    u64 budget;
+    u64 usage;
+    b8 device_local;
+} gpu_memory_heap_stats;
+
+typedef struct gpu_memory_stats {
+    b8 budget_supported;
+    u32 heap_count;
+    gpu_memory_heap_stats heaps[GPU_MEMORY_MAX_HEAPS];
+
+    // Bytes bound to resources of each category, excludes block slack
+    u64 tag_allocated[GPU_MEMORY_TAG_MAX];
+    u32 tag_allocations[GPU_MEMORY_TAG_MAX];
+} gpu_memory_stats;
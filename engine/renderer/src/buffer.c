@@ -4,6 +4,8 @@
 #include "memory/etmemory.h"
 
 #include "renderer/src/renderer.h"
+#include "renderer/src/gpu_memory.h"
+#include "renderer/src/staging.h"
 #include "renderer/src/utilities/vkinit.h"
 #include "renderer/src/utilities/vkutils.h"
 
@@ -12,6 +14,7 @@ void buffer_create(
     u64 size,
     VkBufferUsageFlags usage_flags,
     VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
     buffer* out_buffer
 ) {
     // Does VkBufferCreateInfo need an initializer or does this 
@@ -19,38 +22,23 @@ void buffer_create(
     VkBufferCreateInfo buffer_info = init_buffer_create_info(usage_flags, size);
     VK_CHECK(vkCreateBuffer(state->device.handle, &buffer_info, state->allocator, &out_buffer->handle));
 
-    VkMemoryRequirements2 memory_requirements2 = init_memory_requirements2();
-    VkBufferMemoryRequirementsInfo2 memory_requirements_info =
-        init_buffer_memory_requirements_info2(out_buffer->handle);
-
-    vkGetBufferMemoryRequirements2(state->device.handle, &memory_requirements_info, &memory_requirements2);
-    VkMemoryRequirements memory_requirements = memory_requirements2.memoryRequirements;
-
-    i32 memory_index = find_memory_index(
-        &state->device.gpu_memory_props,
-        memory_requirements.memoryTypeBits,
-        memory_property_flags);
-    if (memory_index == -1) {
-        ETERROR("Supported memory types for buffer not found in physical memory properties.");
-    }
-
-    VkMemoryAllocateFlagsInfo alloc_flags_info;
-    VkMemoryAllocateInfo alloc_info = init_memory_allocate_info(memory_requirements.size, memory_index);
-    if (usage_flags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-        alloc_flags_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-        alloc_flags_info.pNext = 0;
-        alloc_flags_info.deviceMask = 0;
-        alloc_flags_info.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-        alloc_info.pNext = &alloc_flags_info;
+    if (!gpu_memory_allocate_buffer(
+            state,
+            out_buffer->handle,
+            usage_flags,
+            memory_property_flags,
+            tag,
+            &out_buffer->alloc)) {
+        ETERROR("Unable to allocate memory for buffer.");
+        vkDestroyBuffer(state->device.handle, out_buffer->handle, state->allocator);
+        out_buffer->handle = VK_NULL_HANDLE;
+        out_buffer->size = 0;
+        return;
     }
-    VK_CHECK(vkAllocateMemory(
-        state->device.handle,
-        &alloc_info,
-        state->allocator,
-        &out_buffer->memory));
-    VkBindBufferMemoryInfo bind_info = init_bind_buffer_memory_info(out_buffer->handle, out_buffer->memory, 0);
+    VkBindBufferMemoryInfo bind_info = init_bind_buffer_memory_info(
+        out_buffer->handle, out_buffer->alloc.memory, out_buffer->alloc.offset);
     VK_CHECK(vkBindBufferMemory2(state->device.handle, 1, &bind_info));
-    out_buffer->size = memory_requirements.size;
+    out_buffer->size = out_buffer->alloc.size;
 }
 
 void buffer_create_data(
@@ -59,45 +47,21 @@ void buffer_create_data(
     u64 size,
     VkBufferUsageFlags usage_flags,
     VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
     buffer* out_buffer
 ) {
-    buffer staging;
-    buffer_create(
-        state,
-        size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        &staging
-    );
-    void* mapped_memory = 0;
-    VK_CHECK(vkMapMemory(
-        state->device.handle,
-        staging.memory,
-        /* Offset: */ 0,
-        size,
-        /* Flags: */ 0,
-        &mapped_memory));
-    etcopy_memory(mapped_memory, data, size);
-    vkUnmapMemory(state->device.handle, staging.memory);
-
     // Create destination buffer
     buffer_create(
         state,
         size,
         usage_flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         memory_property_flags,
+        tag,
         out_buffer
     );
 
-    IMMEDIATE_SUBMIT(state, cmd,
-        VkBufferCopy buffer_copy = {
-            .dstOffset = 0,
-            .srcOffset = 0,
-            .size = size};
-        vkCmdCopyBuffer(cmd, staging.handle, out_buffer->handle, 1, &buffer_copy);
-    );
-
-    buffer_destroy(state, &staging);
+    staging_upload_buffer(state, out_buffer->handle, /* Offset: */ 0, data, size);
+    staging_flush(state);
 }
 
 VkDeviceAddress buffer_get_address(renderer_state* state, buffer* buffer) {
@@ -109,9 +73,8 @@ VkDeviceAddress buffer_get_address(renderer_state* state, buffer* buffer) {
 }
 
 void buffer_destroy(renderer_state* state, buffer* buffer) {
-    vkFreeMemory(state->device.handle, buffer->memory, state->allocator);
-    buffer->memory = 0;
     vkDestroyBuffer(state->device.handle, buffer->handle, state->allocator);
+    gpu_memory_free(state, &buffer->alloc);
     buffer->handle = 0;
     buffer->size = 0;
 }
@@ -7,6 +7,7 @@ void buffer_create(
     u64 size,
     VkBufferUsageFlags usage_flags,
     VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
     buffer* out_buffer);
 
 void buffer_create_data(
@@ -15,6 +16,7 @@ void buffer_create_data(
     u64 size,
     VkBufferUsageFlags usage_flags,
     VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
     buffer* out_buffer);
 
 VkDeviceAddress buffer_get_address(renderer_state* state, buffer* buffer);
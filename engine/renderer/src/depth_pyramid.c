@@ -0,0 +1,314 @@
+#include "depth_pyramid.h"
+
+#include "core/etstring.h"
+#include "core/logger.h"
+
+#include "renderer/src/renderer.h"
+#include "renderer/src/gpu_memory.h"
+#include "renderer/src/shader.h"
+#include "renderer/src/utilities/vkinit.h"
+
+#define DEPTH_REDUCE_GROUP_SIZE 32
+
+typedef struct depth_reduce_push {
+    v2s dst_size;
+} depth_reduce_push;
+
+static u32 previous_pow2(u32 v);
+
+b8 depth_pyramid_create(renderer_state* state, image* depth_image, depth_pyramid* pyramid) {
+    VkExtent3D extent = {
+        .width = previous_pow2(depth_image->extent.width),
+        .height = previous_pow2(depth_image->extent.height),
+        .depth = 1,
+    };
+    u32 mip_count = 1;
+    while ((extent.width >> mip_count) || (extent.height >> mip_count)) {
+        mip_count++;
+    }
+    if (mip_count > DEPTH_PYRAMID_MAX_MIPS) {
+        mip_count = DEPTH_PYRAMID_MAX_MIPS;
+    }
+    pyramid->mip_count = mip_count;
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    VkImageCreateInfo image_info = init_image2D_create_info(VK_FORMAT_R32_SFLOAT, usage, extent);
+    image_info.mipLevels = mip_count;
+    VK_CHECK(vkCreateImage(state->device.handle, &image_info, state->allocator, &pyramid->image.handle));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_IMAGE, pyramid->image.handle, "DepthPyramidImage");
+
+    if (!gpu_memory_allocate_image(
+            state,
+            pyramid->image.handle,
+            usage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            GPU_MEMORY_TAG_RENDER_TARGET,
+            &pyramid->image.alloc)) {
+        ETERROR("Unable to allocate memory for the depth pyramid.");
+        vkDestroyImage(state->device.handle, pyramid->image.handle, state->allocator);
+        pyramid->image.handle = VK_NULL_HANDLE;
+        return false;
+    }
+    VkBindImageMemoryInfo bind_info = init_bind_image_memory_info(
+        pyramid->image.handle, pyramid->image.alloc.memory, pyramid->image.alloc.offset);
+    VK_CHECK(vkBindImageMemory2(state->device.handle, 1, &bind_info));
+
+    VkImageViewCreateInfo view_info = init_image_view2D_create_info(
+        VK_FORMAT_R32_SFLOAT, pyramid->image.handle, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = mip_count;
+    VK_CHECK(vkCreateImageView(state->device.handle, &view_info, state->allocator, &pyramid->image.view));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_IMAGE_VIEW, pyramid->image.view, "DepthPyramidImageView");
+
+    view_info.subresourceRange.levelCount = 1;
+    for (u32 i = 0; i < mip_count; ++i) {
+        view_info.subresourceRange.baseMipLevel = i;
+        VK_CHECK(vkCreateImageView(state->device.handle, &view_info, state->allocator, &pyramid->mip_views[i]));
+    }
+
+    pyramid->image.extent = extent;
+    pyramid->image.format = VK_FORMAT_R32_SFLOAT;
+    pyramid->image.aspects = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    VkSamplerReductionModeCreateInfo reduction_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO,
+        .pNext = 0,
+        .reductionMode = VK_SAMPLER_REDUCTION_MODE_MIN,
+    };
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = &reduction_info,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+    VK_CHECK(vkCreateSampler(state->device.handle, &sampler_info, state->allocator, &pyramid->reduction_sampler));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_SAMPLER, pyramid->reduction_sampler, "DepthPyramidReductionSampler");
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+        [0] = {
+            .binding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+        [1] = {
+            .binding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = 0,
+        .bindingCount = 2,
+        .pBindings = bindings,
+    };
+    VK_CHECK(vkCreateDescriptorSetLayout(state->device.handle, &set_layout_info, state->allocator, &pyramid->set_layout));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, pyramid->set_layout, "DepthReduceSetLayout");
+
+    VkDescriptorPoolSize sizes[] = {
+        [0] = {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = mip_count,
+        },
+        [1] = {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = mip_count,
+        },
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = 0,
+        .maxSets = mip_count,
+        .poolSizeCount = 2,
+        .pPoolSizes = sizes,
+    };
+    VK_CHECK(vkCreateDescriptorPool(state->device.handle, &pool_info, state->allocator, &pyramid->descriptor_pool));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_DESCRIPTOR_POOL, pyramid->descriptor_pool, "DepthReduceDescriptorPool");
+
+    // Each level reads the level above it, mip 0 reads the depth image
+    for (u32 i = 0; i < mip_count; ++i) {
+        DEBUG_BLOCK(
+            char set_name[] = "DepthReduceSet X";
+            set_name[str_length(set_name) - 1] = 'A' + i;
+        );
+        VkDescriptorSetAllocateInfo set_alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = 0,
+            .descriptorPool = pyramid->descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &pyramid->set_layout,
+        };
+        VK_CHECK(vkAllocateDescriptorSets(state->device.handle, &set_alloc_info, &pyramid->sets[i]));
+        SET_DEBUG_NAME(state, VK_OBJECT_TYPE_DESCRIPTOR_SET, pyramid->sets[i], set_name);
+
+        VkDescriptorImageInfo src_info = {
+            .sampler = pyramid->reduction_sampler,
+            .imageView = i ? pyramid->mip_views[i - 1] : depth_image->view,
+            .imageLayout = i ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+        };
+        VkDescriptorImageInfo dst_info = {
+            .sampler = VK_NULL_HANDLE,
+            .imageView = pyramid->mip_views[i],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+        VkWriteDescriptorSet writes[] = {
+            [0] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = pyramid->sets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &src_info,
+            },
+            [1] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = pyramid->sets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &dst_info,
+            },
+        };
+        vkUpdateDescriptorSets(state->device.handle, 2, writes, 0, NULL);
+    }
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(depth_reduce_push),
+    };
+    VkPipelineLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &pyramid->set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    VK_CHECK(vkCreatePipelineLayout(state->device.handle, &layout_info, state->allocator, &pyramid->pipeline_layout));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE_LAYOUT, pyramid->pipeline_layout, "DepthReducePipelineLayout");
+
+    shader depth_reduce;
+    if (!load_shader(state, "assets/shaders/depth_reduce.comp.spv.opt", &depth_reduce)) {
+        ETERROR("Unable to load depth reduction shader.");
+        return false;
+    }
+    VkPipelineShaderStageCreateInfo stage_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .pNext = 0,
+        .pName = depth_reduce.entry_point,
+        .stage = depth_reduce.stage,
+        .module = depth_reduce.module};
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = pyramid->pipeline_layout,
+        .stage = stage_info};
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &pipeline_info,
+        state->allocator,
+        &pyramid->pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, pyramid->pipeline, "DepthReducePipeline");
+    unload_shader(state, &depth_reduce);
+    return true;
+}
+
+void depth_pyramid_destroy(renderer_state* state, depth_pyramid* pyramid) {
+    vkDestroyPipeline(state->device.handle, pyramid->pipeline, state->allocator);
+    vkDestroyPipelineLayout(state->device.handle, pyramid->pipeline_layout, state->allocator);
+    vkDestroyDescriptorPool(state->device.handle, pyramid->descriptor_pool, state->allocator);
+    vkDestroyDescriptorSetLayout(state->device.handle, pyramid->set_layout, state->allocator);
+    vkDestroySampler(state->device.handle, pyramid->reduction_sampler, state->allocator);
+    for (u32 i = 0; i < pyramid->mip_count; ++i) {
+        vkDestroyImageView(state->device.handle, pyramid->mip_views[i], state->allocator);
+    }
+    vkDestroyImageView(state->device.handle, pyramid->image.view, state->allocator);
+    vkDestroyImage(state->device.handle, pyramid->image.handle, state->allocator);
+    gpu_memory_free(state, &pyramid->image.alloc);
+    pyramid->image.view = VK_NULL_HANDLE;
+    pyramid->image.handle = VK_NULL_HANDLE;
+    pyramid->mip_count = 0;
+}
+
+void depth_pyramid_build(depth_pyramid* pyramid, VkCommandBuffer cmd) {
+    // Previous readers of the pyramid are compute shaders (culling), the contents are discarded
+    VkImageMemoryBarrier2 to_general = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = pyramid->image.handle,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = pyramid->mip_count,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &to_general,
+    };
+    vkCmdPipelineBarrier2(cmd, &dependency);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid->pipeline);
+
+    // Each level waits on the writes to the level it reduces
+    VkMemoryBarrier2 level_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+    };
+    VkDependencyInfo level_dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &level_barrier,
+    };
+    for (u32 i = 0; i < pyramid->mip_count; ++i) {
+        u32 width = pyramid->image.extent.width >> i;
+        u32 height = pyramid->image.extent.height >> i;
+        width = width ? width : 1;
+        height = height ? height : 1;
+
+        depth_reduce_push push = {.dst_size = {.x = (f32)width, .y = (f32)height}};
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid->pipeline_layout, 0, 1, &pyramid->sets[i], 0, NULL);
+        vkCmdPushConstants(cmd, pyramid->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(depth_reduce_push), &push);
+        vkCmdDispatch(cmd,
+            (width + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE,
+            (height + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE,
+            1);
+
+        vkCmdPipelineBarrier2(cmd, &level_dependency);
+    }
+}
+
+static u32 previous_pow2(u32 v) {
+    u32 r = 1;
+    while (r * 2 <= v) {
+        r *= 2;
+    }
+    return r;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "renderer/src/vk_types.h"
+
+/** NOTE: Depth pyramid (Hi-Z)
+ * R32_SFLOAT image with a full mip chain where every texel holds the farthest depth of
+ * the texels it covers in the level below. Mip 0 is the depth image reduced to the
+ * previous power of two of its size so every level halves cleanly.
+ *
+ * The renderer uses reverse-Z so the farthest depth is the smallest, the levels are
+ * reduced with a VK_SAMPLER_REDUCTION_MODE_MIN sampler which also is the sampler used to
+ * read the pyramid when testing bounds against it.
+ *
+ * The image stays in VK_IMAGE_LAYOUT_GENERAL. depth_pyramid_build expects the depth
+ * image to be in VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL & visible to compute shaders,
+ * and leaves the pyramid visible to compute shader reads.
+ */
+
+#define DEPTH_PYRAMID_MAX_MIPS 16
+
+typedef struct depth_pyramid {
+    image image;            // view covers every mip
+    u32 mip_count;
+    VkImageView mip_views[DEPTH_PYRAMID_MAX_MIPS];
+    VkSampler reduction_sampler;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet sets[DEPTH_PYRAMID_MAX_MIPS];
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+} depth_pyramid;
+
+b8 depth_pyramid_create(renderer_state* state, image* depth_image, depth_pyramid* pyramid);
+
+void depth_pyramid_destroy(renderer_state* state, depth_pyramid* pyramid);
+
+void depth_pyramid_build(depth_pyramid* pyramid, VkCommandBuffer cmd);
@@ -27,6 +27,7 @@ typedef struct physical_device_requirements {
     b8 shaderInt64;
     b8 shaderInt16;
     b8 multiDrawIndirect;
+    b8 drawIndirectFirstInstance;
     b8 shaderStorageImageMultisample;
 
     // Vulkan11Features
@@ -34,6 +35,9 @@ typedef struct physical_device_requirements {
 
     // Vulkan12Features
     b8 drawIndirectCount;
+    b8 timelineSemaphore;
+    b8 samplerFilterMinmax;
+    b8 shaderOutputLayer;
     b8 bufferDeviceAddress;
     b8 descriptorIndexing;
     b8 shaderUniformBufferArrayNonUniformIndexing;
@@ -54,6 +58,9 @@ typedef struct physical_device_requirements {
     b8 synchronization2;
     b8 maintenance4;
 
+    // Vulkan11Properties: subgroup operations compute shaders use
+    VkSubgroupFeatureFlags subgroup_operations;
+
     b8 graphics_capable;
     b8 presentation_capable;
     b8 compute_capable;
@@ -74,6 +81,8 @@ static b8 pick_physical_device(renderer_state* state, gpu_reqs* requirements, de
 
 static b8 device_meets_requirements(VkPhysicalDevice device, VkSurfaceKHR surface, gpu_reqs* requirements);
 
+static b8 device_extension_supported(VkPhysicalDevice device, const char* extension_name);
+
 static u32 hamming_weight(u32 x);
 
 b8 device_create(renderer_state* state, device* out_device) {
@@ -81,17 +90,23 @@ b8 device_create(renderer_state* state, device* out_device) {
     u32 required_extension_count = 1;
     const char* required_extensions = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
     gpu_reqs requirements = {
-        .device_extension_count = 1,
+        .device_extension_count = required_extension_count,
         .device_extensions = &required_extensions,
 
         .samplerAnisotropy = true,
         .shaderInt64 = true,
         .shaderInt16 = true,
         .multiDrawIndirect = true,
+        .drawIndirectFirstInstance = true,
 
         .shaderDrawParameters = true,
 
+        .subgroup_operations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT,
+
         .drawIndirectCount = true,
+        .timelineSemaphore = true,
+        .samplerFilterMinmax = true,
+        .shaderOutputLayer = true,
         .bufferDeviceAddress = true,
         .descriptorIndexing = true,
         .shaderUniformBufferArrayNonUniformIndexing = true,
@@ -120,6 +135,17 @@ b8 device_create(renderer_state* state, device* out_device) {
         return false;
     }
 
+    // Optional extensions enabled when the selected gpu supports them
+    u32 enabled_extension_count = 0;
+    const char* enabled_extensions[2];
+    enabled_extensions[enabled_extension_count++] = required_extensions;
+
+    out_device->memory_budget = device_extension_supported(out_device->gpu, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (out_device->memory_budget) {
+        enabled_extensions[enabled_extension_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+    ETINFO("Memory budget extension: %s", out_device->memory_budget ? "enabled" : "not supported");
+
     // Get memory properties from gpu
     VkPhysicalDeviceMemoryProperties2 props = init_physical_device_memory_properties2();
     vkGetPhysicalDeviceMemoryProperties2(out_device->gpu, &props);
@@ -134,6 +160,10 @@ b8 device_create(renderer_state* state, device* out_device) {
         qf_props[i].pNext = 0;
     }
     vkGetPhysicalDeviceQueueFamilyProperties2(out_device->gpu, &queue_family_count, qf_props);
+    out_device->transfer_image_granularity =
+        qf_props[out_device->transfer_qfi].queueFamilyProperties.minImageTransferGranularity;
+    out_device->timestamp_valid_bits =
+        qf_props[out_device->graphics_qfi].queueFamilyProperties.timestampValidBits;
 
     // Create bitmasks for each possible queue family
     u32* qfi_flags = etallocate(sizeof(u32) * queue_family_count, MEMORY_TAG_RENDERER);
@@ -194,6 +224,9 @@ b8 device_create(renderer_state* state, device* out_device) {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
         .pNext = &enabled_features13,
         .drawIndirectCount = requirements.drawIndirectCount,
+        .timelineSemaphore = requirements.timelineSemaphore,
+        .samplerFilterMinmax = requirements.samplerFilterMinmax,
+        .shaderOutputLayer = requirements.shaderOutputLayer,
         .bufferDeviceAddress = requirements.bufferDeviceAddress,
         .descriptorIndexing = requirements.descriptorIndexing,
         .shaderUniformBufferArrayNonUniformIndexing = requirements.shaderUniformBufferArrayNonUniformIndexing,
@@ -222,6 +255,7 @@ b8 device_create(renderer_state* state, device* out_device) {
             .shaderInt16 = requirements.shaderInt16,
             .shaderInt64 = requirements.shaderInt64,
             .multiDrawIndirect = requirements.multiDrawIndirect,
+            .drawIndirectFirstInstance = requirements.drawIndirectFirstInstance,
         },
     };
 
@@ -231,8 +265,8 @@ b8 device_create(renderer_state* state, device* out_device) {
         .flags = 0,
         .queueCreateInfoCount = index_count,
         .pQueueCreateInfos = queue_cinfos,
-        .enabledExtensionCount = required_extension_count,
-        .ppEnabledExtensionNames = &required_extensions,
+        .enabledExtensionCount = enabled_extension_count,
+        .ppEnabledExtensionNames = enabled_extensions,
         .pEnabledFeatures = 0,
 
         .enabledLayerCount = 0,     // Depricated
@@ -270,7 +304,7 @@ b8 device_create(renderer_state* state, device* out_device) {
     b8 c_max_queues = (curr_queue_indices[out_device->compute_qfi] == queue_counts[out_device->compute_qfi]);
     vkGetDeviceQueue(
         out_device->handle,
-        out_device->present_qfi,
+        out_device->compute_qfi,
         (c_max_queues) ? 0 : curr_queue_indices[out_device->compute_qfi]++,
         &out_device->compute_queue);
 
@@ -448,6 +482,10 @@ static b8 device_meets_requirements(VkPhysicalDevice device, VkSurfaceKHR surfac
         ETFATAL("Feature multiDrawIndirect is required and not supported on this device.");
         supported = false;
     }
+    if (requirements->drawIndirectFirstInstance && !features.drawIndirectFirstInstance) {
+        ETFATAL("Feature drawIndirectFirstInstance is required and not supported on this device.");
+        supported = false;
+    }
 
     // Features 11
     if (requirements->shaderDrawParameters && !features11.shaderDrawParameters) {
@@ -455,11 +493,39 @@ static b8 device_meets_requirements(VkPhysicalDevice device, VkSurfaceKHR surfac
         supported = false;
     }
 
+    // Properties 11
+    VkPhysicalDeviceVulkan11Properties properties11 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES,
+        .pNext = 0,
+    };
+    VkPhysicalDeviceProperties2 properties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &properties11,
+    };
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+    if (!(properties11.subgroupSupportedStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+        (properties11.subgroupSupportedOperations & requirements->subgroup_operations) != requirements->subgroup_operations) {
+        ETFATAL("Subgroup basic, arithmetic & ballot operations in compute shaders are required & not supported on this device.");
+        supported = false;
+    }
+
     // Features 12
     if (requirements->drawIndirectCount && !features12.drawIndirectCount) {
         ETFATAL("Feature drawIndirectCount is required & not supported on this device.");
         supported = false;
     }
+    if (requirements->timelineSemaphore && !features12.timelineSemaphore) {
+        ETFATAL("Feature timelineSemaphore is required & not supported on this device.");
+        supported = false;
+    }
+    if (requirements->samplerFilterMinmax && !features12.samplerFilterMinmax) {
+        ETFATAL("Feature samplerFilterMinmax is required & not supported on this device.");
+        supported = false;
+    }
+    if (requirements->shaderOutputLayer && !features12.shaderOutputLayer) {
+        ETFATAL("Feature shaderOutputLayer is required & not supported on this device.");
+        supported = false;
+    }
     if (requirements->bufferDeviceAddress && !features12.bufferDeviceAddress) {
         ETFATAL("Feature bufferDeviceAddress is required & not supported on this device.");
         supported = false;
@@ -662,6 +728,23 @@ static b8 device_meets_requirements(VkPhysicalDevice device, VkSurfaceKHR surfac
     return true;
 }
 
+static b8 device_extension_supported(VkPhysicalDevice device, const char* extension_name) {
+    u32 extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, 0, &extension_count, 0);
+    VkExtensionProperties* extensions = dynarray_create(extension_count, sizeof(VkExtensionProperties));
+    vkEnumerateDeviceExtensionProperties(device, 0, &extension_count, extensions);
+
+    b8 found = false;
+    for (u32 i = 0; i < extension_count; ++i) {
+        if (strs_equal(extension_name, extensions[i].extensionName)) {
+            found = true;
+            break;
+        }
+    }
+    dynarray_destroy(extensions);
+    return found;
+}
+
 static u32 hamming_weight(u32 x) {
 #if defined(__GNUC__) || defined(__clang__)
 return __builtin_popcount(x);
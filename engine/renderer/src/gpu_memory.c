@@ -0,0 +1,580 @@
+#include "gpu_memory.h"
+
+#include "core/logger.h"
+#include "memory/etmemory.h"
+#include "data_structures/dynarray.h"
+
+#include "renderer/src/renderer.h"
+#include "renderer/src/utilities/vkinit.h"
+#include "renderer/src/utilities/vkutils.h"
+
+#include <stdio.h>
+
+/** TODO:
+ * Non coherent host visible memory types need vkFlushMappedMemoryRanges aligned to nonCoherentAtomSize.
+ *     Every host visible allocation currently requests VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+ * Defragmentation of partially used blocks
+ */
+
+static b8 gpu_memory_allocate(
+    renderer_state* state,
+    VkMemoryRequirements requirements,
+    VkMemoryPropertyFlags memory_property_flags,
+    b8 dedicated,
+    VkMemoryDedicatedAllocateInfo dedicated_info,
+    b8 device_address,
+    gpu_memory_tag tag,
+    gpu_allocation* out_allocation);
+
+static b8 memory_allocate(
+    renderer_state* state,
+    u64 size,
+    u32 memory_type,
+    const VkMemoryDedicatedAllocateInfo* dedicated_info,
+    b8 device_address,
+    VkDeviceMemory* out_memory,
+    void** out_mapped);
+
+static void memory_free(renderer_state* state, VkDeviceMemory memory, u64 size, u32 memory_type);
+
+static b8 block_allocate(gpu_memory_block* block, u64 size, u64 alignment, u64* out_offset);
+static void block_free(gpu_memory_block* block, u64 offset, u64 size);
+
+static inline gpu_memory_pool* memory_pool(gpu_allocator* allocator, u32 memory_type, b8 device_address) {
+    return &allocator->pools[device_address ? allocator->memory_type_count + memory_type : memory_type];
+}
+
+static inline u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline void gpu_memory_tag_add(gpu_allocator* allocator, gpu_memory_tag tag, u64 size) {
+    allocator->tag_allocated[tag] += size;
+    allocator->tag_allocations[tag]++;
+}
+
+static const char* gpu_memory_strings[GPU_MEMORY_TAG_MAX] = {
+    "Render target: ",
+    "Texture:       ",
+    "Geometry:      ",
+    "Scene:         ",
+    "Draws:         ",
+    "Material:      ",
+    "Staging:       ",
+};
+
+// Short names for the single line budget log
+static const char* gpu_memory_short_strings[GPU_MEMORY_TAG_MAX] = {
+    "rt",
+    "tex",
+    "geo",
+    "scene",
+    "draws",
+    "mat",
+    "staging",
+};
+
+b8 gpu_allocator_initialize(renderer_state* state, gpu_allocator* allocator) {
+    const VkPhysicalDeviceMemoryProperties* memory_props = &state->device.gpu_memory_props;
+
+    etzero_memory(allocator, sizeof(gpu_allocator));
+    allocator->granularity = state->device.gpu_limits.bufferImageGranularity;
+    allocator->memory_type_count = memory_props->memoryTypeCount;
+    allocator->pool_count = 2 * allocator->memory_type_count;
+    for (u32 i = 0; i < allocator->pool_count; ++i) {
+        gpu_memory_pool* pool = &allocator->pools[i];
+        pool->memory_type = i % allocator->memory_type_count;
+        pool->device_address = i >= allocator->memory_type_count;
+
+        // Keep blocks small enough that a handful fit in small heaps (e.g. 256MiB BAR heaps)
+        u64 heap_size = memory_props->memoryHeaps[memory_props->memoryTypes[pool->memory_type].heapIndex].size;
+        pool->block_size = GPU_MEMORY_BLOCK_SIZE;
+        while (pool->block_size > heap_size / 8 && pool->block_size > 1024 * 1024) {
+            pool->block_size /= 2;
+        }
+
+        pool->blocks = dynarray_create(1, sizeof(gpu_memory_block));
+        pool->dedicated_count = 0;
+        pool->dedicated_size = 0;
+    }
+    ETINFO("GPU memory allocator initialized with %lu pools.", allocator->pool_count);
+    return true;
+}
+
+void gpu_allocator_shutdown(renderer_state* state, gpu_allocator* allocator) {
+    for (u32 i = 0; i < allocator->pool_count; ++i) {
+        gpu_memory_pool* pool = &allocator->pools[i];
+        if (pool->dedicated_count) {
+            ETWARN("GPU memory pool %lu has %lu dedicated allocations still alive at shutdown.", i, pool->dedicated_count);
+        }
+
+        u32 block_count = dynarray_length(pool->blocks);
+        for (u32 j = 0; j < block_count; ++j) {
+            gpu_memory_block* block = &pool->blocks[j];
+            if (block->memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            if (block->allocation_count) {
+                ETWARN("GPU memory pool %lu block %lu has %lu allocations still alive at shutdown.",
+                    i, j, block->allocation_count);
+            }
+            memory_free(state, block->memory, block->size, pool->memory_type);
+            dynarray_destroy(block->free_ranges);
+        }
+        dynarray_destroy(pool->blocks);
+        pool->blocks = 0;
+    }
+    allocator->pool_count = 0;
+    ETINFO("GPU memory allocator shutdown.");
+}
+
+b8 gpu_memory_allocate_buffer(
+    renderer_state* state,
+    VkBuffer buffer,
+    VkBufferUsageFlags usage_flags,
+    VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
+    gpu_allocation* out_allocation
+) {
+    VkMemoryDedicatedRequirements dedicated_requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+        .pNext = 0,
+    };
+    VkMemoryRequirements2 memory_requirements2 = init_memory_requirements2();
+    memory_requirements2.pNext = &dedicated_requirements;
+    VkBufferMemoryRequirementsInfo2 memory_requirements_info =
+        init_buffer_memory_requirements_info2(buffer);
+
+    vkGetBufferMemoryRequirements2(state->device.handle, &memory_requirements_info, &memory_requirements2);
+
+    b8 dedicated = dedicated_requirements.requiresDedicatedAllocation ||
+        dedicated_requirements.prefersDedicatedAllocation;
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext = 0,
+        .image = VK_NULL_HANDLE,
+        .buffer = buffer,
+    };
+    b8 device_address = (usage_flags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0;
+    return gpu_memory_allocate(
+        state,
+        memory_requirements2.memoryRequirements,
+        memory_property_flags,
+        dedicated,
+        dedicated_info,
+        device_address,
+        tag,
+        out_allocation);
+}
+
+b8 gpu_memory_allocate_image(
+    renderer_state* state,
+    VkImage image,
+    VkImageUsageFlags usage_flags,
+    VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
+    gpu_allocation* out_allocation
+) {
+    VkMemoryDedicatedRequirements dedicated_requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+        .pNext = 0,
+    };
+    VkMemoryRequirements2 memory_requirements2 = init_memory_requirements2();
+    memory_requirements2.pNext = &dedicated_requirements;
+    VkImageMemoryRequirementsInfo2 memory_requirements_info =
+        init_image_memory_requirements_info2(image);
+
+    vkGetImageMemoryRequirements2(state->device.handle, &memory_requirements_info, &memory_requirements2);
+    VkMemoryRequirements memory_requirements = memory_requirements2.memoryRequirements;
+
+    const VkImageUsageFlags render_target_usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    b8 large_render_target = (usage_flags & render_target_usage) &&
+        memory_requirements.size >= GPU_MEMORY_DEDICATED_THRESHOLD;
+
+    b8 dedicated = large_render_target ||
+        dedicated_requirements.requiresDedicatedAllocation ||
+        dedicated_requirements.prefersDedicatedAllocation;
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext = 0,
+        .image = image,
+        .buffer = VK_NULL_HANDLE,
+    };
+    return gpu_memory_allocate(
+        state,
+        memory_requirements,
+        memory_property_flags,
+        dedicated,
+        dedicated_info,
+        /* device_address: */ false,
+        tag,
+        out_allocation);
+}
+
+void gpu_memory_free(renderer_state* state, gpu_allocation* allocation) {
+    if (allocation->memory == VK_NULL_HANDLE) {
+        return;
+    }
+    gpu_allocator* allocator = &state->gpu_allocator;
+    gpu_memory_pool* pool = memory_pool(allocator, allocation->memory_type, allocation->device_address);
+    allocator->tag_allocated[allocation->tag] -= allocation->size;
+    allocator->tag_allocations[allocation->tag]--;
+
+    if (allocation->block_index == INVALID_ID) {
+        memory_free(state, allocation->memory, allocation->size, allocation->memory_type);
+        pool->dedicated_count--;
+        pool->dedicated_size -= allocation->size;
+    } else {
+        gpu_memory_block* block = &pool->blocks[allocation->block_index];
+        block_free(block, allocation->offset, allocation->size);
+
+        // Release empty blocks back to the driver unless it would leave the pool without one,
+        // the slot is reused by the next block
+        if (block->allocation_count == 0) {
+            b8 spare = false;
+            u32 block_slots = dynarray_length(pool->blocks);
+            for (u32 i = 0; i < block_slots && !spare; ++i) {
+                gpu_memory_block* other = &pool->blocks[i];
+                spare = i != allocation->block_index && other->memory != VK_NULL_HANDLE && other->allocation_count == 0;
+            }
+            if (spare) {
+                memory_free(state, block->memory, block->size, allocation->memory_type);
+                dynarray_destroy(block->free_ranges);
+                etzero_memory(block, sizeof(gpu_memory_block));
+            }
+        }
+    }
+    etzero_memory(allocation, sizeof(gpu_allocation));
+    allocation->block_index = INVALID_ID;
+}
+
+void gpu_memory_get_stats(renderer_state* state, gpu_memory_stats* out_stats) {
+    gpu_allocator* allocator = &state->gpu_allocator;
+    etzero_memory(out_stats, sizeof(gpu_memory_stats));
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        .pNext = 0,
+    };
+    VkPhysicalDeviceMemoryProperties2 memory_props2 = init_physical_device_memory_properties2();
+    if (state->device.memory_budget) {
+        memory_props2.pNext = &budget_props;
+        vkGetPhysicalDeviceMemoryProperties2(state->device.gpu, &memory_props2);
+    } else {
+        memory_props2.memoryProperties = state->device.gpu_memory_props;
+    }
+    const VkPhysicalDeviceMemoryProperties* memory_props = &memory_props2.memoryProperties;
+
+    out_stats->budget_supported = state->device.memory_budget;
+    out_stats->heap_count = memory_props->memoryHeapCount;
+    ETASSERT(out_stats->heap_count <= GPU_MEMORY_MAX_HEAPS);
+    for (u32 i = 0; i < out_stats->heap_count; ++i) {
+        gpu_memory_heap_stats* heap = &out_stats->heaps[i];
+        heap->size = memory_props->memoryHeaps[i].size;
+        heap->device_local = (memory_props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap->allocated = allocator->heap_allocated[i];
+        if (state->device.memory_budget) {
+            heap->budget = budget_props.heapBudget[i];
+            heap->usage = budget_props.heapUsage[i];
+        } else {
+            heap->budget = heap->size;
+            heap->usage = heap->allocated;
+        }
+    }
+
+    for (u32 i = 0; i < GPU_MEMORY_TAG_MAX; ++i) {
+        out_stats->tag_allocated[i] = allocator->tag_allocated[i];
+        out_stats->tag_allocations[i] = allocator->tag_allocations[i];
+    }
+}
+
+void gpu_memory_print_metrics(renderer_state* state) {
+    const f32 mib = 1024.0f * 1024.0f;
+    gpu_allocator* allocator = &state->gpu_allocator;
+
+    gpu_memory_stats stats;
+    gpu_memory_get_stats(state, &stats);
+
+    ETDEBUG("GPU memory usage [tagged]:");
+    for (u32 i = 0; i < GPU_MEMORY_TAG_MAX; ++i) {
+        ETDEBUG("%s%8.2fMiB (%lu allocations)",
+            gpu_memory_strings[i], stats.tag_allocated[i] / mib, stats.tag_allocations[i]);
+    }
+
+    ETDEBUG("GPU memory usage [per heap]%s:", stats.budget_supported ? "" : " (no budget extension, budget is heap size)");
+    for (u32 i = 0; i < stats.heap_count; ++i) {
+        gpu_memory_heap_stats* heap = &stats.heaps[i];
+        ETDEBUG("Heap %lu%s: %8.2fMiB allocated, %8.2fMiB usage / %8.2fMiB budget, %8.2fMiB size",
+            i, heap->device_local ? " (device local)" : "",
+            heap->allocated / mib, heap->usage / mib, heap->budget / mib, heap->size / mib);
+    }
+
+    ETDEBUG("GPU memory usage [per memory type]:");
+    for (u32 i = 0; i < allocator->pool_count; ++i) {
+        gpu_memory_pool* pool = &allocator->pools[i];
+
+        u32 block_count = 0;
+        u32 allocation_count = 0;
+        u64 reserved = 0;
+        u64 used = 0;
+        u32 block_slots = dynarray_length(pool->blocks);
+        for (u32 j = 0; j < block_slots; ++j) {
+            gpu_memory_block* block = &pool->blocks[j];
+            if (block->memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            block_count++;
+            allocation_count += block->allocation_count;
+            reserved += block->size;
+            used += block->used;
+        }
+        if (block_count == 0 && pool->dedicated_count == 0) {
+            continue;
+        }
+        ETDEBUG("Type %2lu%s: %lu blocks %8.2fMiB used / %8.2fMiB reserved (%lu allocations), %lu dedicated %8.2fMiB",
+            pool->memory_type, pool->device_address ? " (device address)" : "", block_count, used / mib, reserved / mib, allocation_count,
+            pool->dedicated_count, pool->dedicated_size / mib);
+    }
+}
+
+void gpu_memory_log_budget(renderer_state* state) {
+    const f32 mib = 1024.0f * 1024.0f;
+    gpu_memory_stats stats;
+    gpu_memory_get_stats(state, &stats);
+
+    u64 usage = 0, budget = 0;
+    for (u32 i = 0; i < stats.heap_count; ++i) {
+        if (stats.heaps[i].device_local) {
+            usage += stats.heaps[i].usage;
+            budget += stats.heaps[i].budget;
+        }
+    }
+
+    char categories[256];
+    u32 offset = 0;
+    categories[0] = '\0';
+    for (u32 i = 0; i < GPU_MEMORY_TAG_MAX && offset < sizeof(categories); ++i) {
+        offset += snprintf(categories + offset, sizeof(categories) - offset, " %s %.1f",
+            gpu_memory_short_strings[i], stats.tag_allocated[i] / mib);
+    }
+    ETINFO("VRAM %.1f / %.1fMiB%s |%s (MiB)",
+        usage / mib, budget / mib, stats.budget_supported ? "" : " (heap size)", categories);
+}
+
+static b8 gpu_memory_allocate(
+    renderer_state* state,
+    VkMemoryRequirements requirements,
+    VkMemoryPropertyFlags memory_property_flags,
+    b8 dedicated,
+    VkMemoryDedicatedAllocateInfo dedicated_info,
+    b8 device_address,
+    gpu_memory_tag tag,
+    gpu_allocation* out_allocation
+) {
+    i32 memory_index = find_memory_index(
+        &state->device.gpu_memory_props,
+        requirements.memoryTypeBits,
+        memory_property_flags);
+    if (memory_index == -1) {
+        ETERROR("Supported memory types for allocation not found in physical memory properties.");
+        return false;
+    }
+    gpu_memory_pool* pool = memory_pool(&state->gpu_allocator, memory_index, device_address);
+
+    out_allocation->memory_type = (u32)memory_index;
+    out_allocation->device_address = device_address;
+    out_allocation->size = requirements.size;
+    out_allocation->tag = tag;
+
+    // NOTE: The memory is owned by the resource alone, so the driver is told which one it is
+    if (dedicated || requirements.size > pool->block_size / 2) {
+        if (!memory_allocate(state, requirements.size, memory_index, &dedicated_info, device_address,
+                &out_allocation->memory, &out_allocation->mapped)) {
+            return false;
+        }
+        out_allocation->offset = 0;
+        out_allocation->block_index = INVALID_ID;
+        pool->dedicated_count++;
+        pool->dedicated_size += requirements.size;
+        gpu_memory_tag_add(&state->gpu_allocator, tag, requirements.size);
+        return true;
+    }
+
+    u64 alignment = requirements.alignment;
+    if (alignment < state->gpu_allocator.granularity) {
+        alignment = state->gpu_allocator.granularity;
+    }
+
+    u32 block_slots = dynarray_length(pool->blocks);
+    u32 free_slot = INVALID_ID;
+    for (u32 i = 0; i < block_slots; ++i) {
+        gpu_memory_block* block = &pool->blocks[i];
+        if (block->memory == VK_NULL_HANDLE) {
+            free_slot = (free_slot == INVALID_ID) ? i : free_slot;
+            continue;
+        }
+        u64 offset;
+        if (block_allocate(block, requirements.size, alignment, &offset)) {
+            out_allocation->memory = block->memory;
+            out_allocation->offset = offset;
+            out_allocation->mapped = block->mapped ? (u8*)block->mapped + offset : 0;
+            out_allocation->block_index = i;
+            gpu_memory_tag_add(&state->gpu_allocator, tag, requirements.size);
+            return true;
+        }
+    }
+
+    // No block had room, create a new one
+    gpu_memory_block new_block = {0};
+    if (!memory_allocate(state, pool->block_size, memory_index, /* dedicated_info: */ NULL, device_address, &new_block.memory, &new_block.mapped)) {
+        return false;
+    }
+    new_block.size = pool->block_size;
+    new_block.free_ranges = dynarray_create(4, sizeof(gpu_memory_range));
+    gpu_memory_range whole = {.offset = 0, .size = new_block.size};
+    dynarray_push((void**)&new_block.free_ranges, &whole);
+
+    if (free_slot == INVALID_ID) {
+        free_slot = block_slots;
+        dynarray_push((void**)&pool->blocks, &new_block);
+    } else {
+        pool->blocks[free_slot] = new_block;
+    }
+
+    gpu_memory_block* block = &pool->blocks[free_slot];
+    u64 offset = 0;
+    b8 allocated = block_allocate(block, requirements.size, alignment, &offset);
+    ETASSERT(allocated);
+
+    out_allocation->memory = block->memory;
+    out_allocation->offset = offset;
+    out_allocation->mapped = block->mapped ? (u8*)block->mapped + offset : 0;
+    out_allocation->block_index = free_slot;
+    gpu_memory_tag_add(&state->gpu_allocator, tag, requirements.size);
+    return true;
+}
+
+static b8 memory_allocate(
+    renderer_state* state,
+    u64 size,
+    u32 memory_type,
+    const VkMemoryDedicatedAllocateInfo* dedicated_info,
+    b8 device_address,
+    VkDeviceMemory* out_memory,
+    void** out_mapped
+) {
+    // NOTE: Only memory for buffers read through their device address needs the flag
+    VkMemoryAllocateFlagsInfo alloc_flags_info = init_memory_allocate_flags_info(VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+    VkMemoryAllocateInfo alloc_info = init_memory_allocate_info(size, memory_type);
+    alloc_info.pNext = device_address ? &alloc_flags_info : 0;
+
+    // Dedicated allocations name their resource in front of the flags
+    VkMemoryDedicatedAllocateInfo dedicated_alloc_info;
+    if (dedicated_info) {
+        dedicated_alloc_info = *dedicated_info;
+        dedicated_alloc_info.pNext = alloc_info.pNext;
+        alloc_info.pNext = &dedicated_alloc_info;
+    }
+
+    VkResult result = vkAllocateMemory(state->device.handle, &alloc_info, state->allocator, out_memory);
+    if (result != VK_SUCCESS) {
+        ETERROR("vkAllocateMemory failed for %llu bytes of memory type %lu.", size, memory_type);
+        return false;
+    }
+    u32 heap_index = state->device.gpu_memory_props.memoryTypes[memory_type].heapIndex;
+    state->gpu_allocator.heap_allocated[heap_index] += size;
+
+    *out_mapped = 0;
+    VkMemoryPropertyFlags flags = state->device.gpu_memory_props.memoryTypes[memory_type].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(
+            state->device.handle,
+            *out_memory,
+            /* Offset: */ 0,
+            VK_WHOLE_SIZE,
+            /* Flags: */ 0,
+            out_mapped));
+    }
+    return true;
+}
+
+static void memory_free(renderer_state* state, VkDeviceMemory memory, u64 size, u32 memory_type) {
+    vkFreeMemory(state->device.handle, memory, state->allocator);
+    u32 heap_index = state->device.gpu_memory_props.memoryTypes[memory_type].heapIndex;
+    state->gpu_allocator.heap_allocated[heap_index] -= size;
+}
+
+static b8 block_allocate(gpu_memory_block* block, u64 size, u64 alignment, u64* out_offset) {
+    u32 range_count = dynarray_length(block->free_ranges);
+    for (u32 i = 0; i < range_count; ++i) {
+        gpu_memory_range* range = &block->free_ranges[i];
+        u64 aligned = align_up(range->offset, alignment);
+        u64 padding = aligned - range->offset;
+        if (range->size < padding + size) {
+            continue;
+        }
+
+        u64 range_end = range->offset + range->size;
+        u64 allocation_end = aligned + size;
+        if (padding) {
+            // Alignment padding stays in the free list as its own range
+            range->size = padding;
+            if (allocation_end < range_end) {
+                gpu_memory_range tail = {.offset = allocation_end, .size = range_end - allocation_end};
+                if (i + 1 < range_count) {
+                    dynarray_insert((void**)&block->free_ranges, &tail, i + 1);
+                } else {
+                    dynarray_push((void**)&block->free_ranges, &tail);
+                }
+            }
+        } else if (allocation_end < range_end) {
+            range->offset = allocation_end;
+            range->size = range_end - allocation_end;
+        } else {
+            gpu_memory_range removed;
+            dynarray_remove(block->free_ranges, &removed, i);
+        }
+
+        block->used += size;
+        block->allocation_count++;
+        *out_offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+static void block_free(gpu_memory_block* block, u64 offset, u64 size) {
+    block->used -= size;
+    block->allocation_count--;
+
+    // Find the first free range after the freed range
+    u32 range_count = dynarray_length(block->free_ranges);
+    u32 index = 0;
+    while (index < range_count && block->free_ranges[index].offset < offset) {
+        index++;
+    }
+
+    b8 merge_prev = index > 0 &&
+        block->free_ranges[index - 1].offset + block->free_ranges[index - 1].size == offset;
+    b8 merge_next = index < range_count &&
+        offset + size == block->free_ranges[index].offset;
+
+    if (merge_prev && merge_next) {
+        block->free_ranges[index - 1].size += size + block->free_ranges[index].size;
+        gpu_memory_range removed;
+        dynarray_remove(block->free_ranges, &removed, index);
+    } else if (merge_prev) {
+        block->free_ranges[index - 1].size += size;
+    } else if (merge_next) {
+        block->free_ranges[index].offset = offset;
+        block->free_ranges[index].size += size;
+    } else {
+        gpu_memory_range range = {.offset = offset, .size = size};
+        if (index < range_count) {
+            dynarray_insert((void**)&block->free_ranges, &range, index);
+        } else {
+            dynarray_push((void**)&block->free_ranges, &range);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "renderer/src/vk_types.h"
+
+/** NOTE: GPU memory sub-allocation
+ * Device memory is allocated in large blocks, one pool of blocks per memory type, and
+ * buffers & images are bound to aligned sub-ranges of those blocks. Each block keeps
+ * a free list of ranges sorted by offset, allocation is first fit and freed ranges are
+ * merged with their neighbours. Blocks of host visible memory types are persistently
+ * mapped, so gpu_allocation::mapped can be written to directly.
+ *
+ * Large render targets & resources the driver prefers to be dedicated get their own
+ * VkDeviceMemory so they do not fragment the blocks. Memory owned by a single resource is
+ * allocated with VkMemoryDedicatedAllocateInfo naming it.
+ *
+ * Offsets are aligned to bufferImageGranularity as well as the resources alignment so
+ * that linear & optimal resources can share a block.
+ *
+ * Buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT must be bound to memory allocated with
+ * VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT. Each memory type has a second pool of blocks allocated
+ * with the flag for them, the other resources are kept out of it.
+ *
+ * An emptied block is released unless it is the pool's only empty block, which is kept so
+ * that a resource recreated every so often does not allocate & free a block each time.
+ *
+ * Every allocation is tagged with a gpu_memory_tag and the allocator keeps per tag and
+ * per heap totals. When VK_EXT_memory_budget is enabled the heap budgets reported by the
+ * driver are included in gpu_memory_get_stats.
+ */
+
+#define GPU_MEMORY_BLOCK_SIZE (64ull * 1024 * 1024)
+// Render targets at or above this size get a dedicated allocation
+#define GPU_MEMORY_DEDICATED_THRESHOLD (16ull * 1024 * 1024)
+
+typedef struct gpu_memory_range {
+    u64 offset;
+    u64 size;
+} gpu_memory_range;
+
+typedef struct gpu_memory_block {
+    // VK_NULL_HANDLE when the block has been released and the slot can be reused
+    VkDeviceMemory memory;
+    u64 size;
+    u64 used;
+    u32 allocation_count;
+    void* mapped;
+
+    gpu_memory_range* free_ranges;  // Dynarray, sorted by offset
+} gpu_memory_block;
+
+typedef struct gpu_memory_pool {
+    u32 memory_type;
+    b8 device_address;              // Blocks are allocated with VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+    u64 block_size;
+    gpu_memory_block* blocks;       // Dynarray
+
+    u32 dedicated_count;
+    u64 dedicated_size;
+} gpu_memory_pool;
+
+typedef struct gpu_allocator {
+    u64 granularity;
+    u32 memory_type_count;
+    // One pool per memory type, followed by the device address pool of each memory type
+    u32 pool_count;
+    gpu_memory_pool pools[2 * VK_MAX_MEMORY_TYPES];
+
+    u64 tag_allocated[GPU_MEMORY_TAG_MAX];
+    u32 tag_allocations[GPU_MEMORY_TAG_MAX];
+    // VkDeviceMemory allocated per heap
+    u64 heap_allocated[VK_MAX_MEMORY_HEAPS];
+} gpu_allocator;
+
+b8 gpu_allocator_initialize(renderer_state* state, gpu_allocator* allocator);
+
+void gpu_allocator_shutdown(renderer_state* state, gpu_allocator* allocator);
+
+b8 gpu_memory_allocate_buffer(
+    renderer_state* state,
+    VkBuffer buffer,
+    VkBufferUsageFlags usage_flags,
+    VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
+    gpu_allocation* out_allocation);
+
+b8 gpu_memory_allocate_image(
+    renderer_state* state,
+    VkImage image,
+    VkImageUsageFlags usage_flags,
+    VkMemoryPropertyFlags memory_property_flags,
+    gpu_memory_tag tag,
+    gpu_allocation* out_allocation);
+
+void gpu_memory_free(renderer_state* state, gpu_allocation* allocation);
+
+void gpu_memory_get_stats(renderer_state* state, gpu_memory_stats* out_stats);
+
+void gpu_memory_print_metrics(renderer_state* state);
+
+// Single line summary of device local heap usage against budget & the largest categories
+void gpu_memory_log_budget(renderer_state* state);
@@ -6,6 +6,8 @@
 #include "renderer/src/utilities/vkinit.h"
 #include "renderer/src/utilities/vkutils.h"
 #include "renderer/src/renderer.h"
+#include "renderer/src/gpu_memory.h"
+#include "renderer/src/staging.h"
 #include "renderer/src/buffer.h"
 
 /** TODO:
@@ -25,34 +27,74 @@ void image2D_create(
     VkImageUsageFlags usage_flags,
     VkImageAspectFlags aspect_flags,
     VkMemoryPropertyFlags memory_flags,
+    gpu_memory_tag tag,
     image* out_image
 ) {
     VkImageCreateInfo image_info = init_image2D_create_info(format, usage_flags, extent);
     VK_CHECK(vkCreateImage(state->device.handle, &image_info, state->allocator, &out_image->handle));
 
-    VkMemoryRequirements2 memory_requirements2 = init_memory_requirements2();
-    VkImageMemoryRequirementsInfo2 memory_requirements_info2 = 
-        init_image_memory_requirements_info2(out_image->handle);
-    
-    vkGetImageMemoryRequirements2(state->device.handle, &memory_requirements_info2, &memory_requirements2);
-    VkMemoryRequirements memory_requirements = memory_requirements2.memoryRequirements;
-
-    u32 memory_index = find_memory_index(
-        &state->device.gpu_memory_props,
-        memory_requirements.memoryTypeBits,
-        memory_flags);
-    if (memory_index == -1) {
-        ETERROR("Memory type with required memory type bits for image not found in physical memory properties.");
+    if (!gpu_memory_allocate_image(
+            state,
+            out_image->handle,
+            usage_flags,
+            memory_flags,
+            tag,
+            &out_image->alloc)) {
+        ETERROR("Unable to allocate memory for image.");
+        vkDestroyImage(state->device.handle, out_image->handle, state->allocator);
+        out_image->handle = VK_NULL_HANDLE;
+        return;
     }
 
-    VkMemoryAllocateInfo alloc_info = init_memory_allocate_info(memory_requirements.size, memory_index);
-    VK_CHECK(vkAllocateMemory(state->device.handle, &alloc_info, state->allocator, &out_image->memory));
+    VkBindImageMemoryInfo bind_info = init_bind_image_memory_info(
+        out_image->handle, out_image->alloc.memory, out_image->alloc.offset);
+    VK_CHECK(vkBindImageMemory2(state->device.handle, 1, &bind_info));
+
+    VkImageViewCreateInfo view_info = init_image_view2D_create_info(
+        format, out_image->handle, aspect_flags);
+    VK_CHECK(vkCreateImageView(state->device.handle, &view_info, state->allocator, &out_image->view));
+
+    out_image->extent = extent;
+    out_image->format = format;
+    out_image->aspects = aspect_flags;
+}
 
-    VkBindImageMemoryInfo bind_info = init_bind_image_memory_info(out_image->handle, out_image->memory, 0);
+void image2D_array_create(
+    renderer_state* state,
+    VkExtent3D extent,
+    u32 layer_count,
+    VkFormat format,
+    VkImageUsageFlags usage_flags,
+    VkImageAspectFlags aspect_flags,
+    VkMemoryPropertyFlags memory_flags,
+    gpu_memory_tag tag,
+    image* out_image
+) {
+    VkImageCreateInfo image_info = init_image2D_create_info(format, usage_flags, extent);
+    image_info.arrayLayers = layer_count;
+    VK_CHECK(vkCreateImage(state->device.handle, &image_info, state->allocator, &out_image->handle));
+
+    if (!gpu_memory_allocate_image(
+            state,
+            out_image->handle,
+            usage_flags,
+            memory_flags,
+            tag,
+            &out_image->alloc)) {
+        ETERROR("Unable to allocate memory for image.");
+        vkDestroyImage(state->device.handle, out_image->handle, state->allocator);
+        out_image->handle = VK_NULL_HANDLE;
+        return;
+    }
+
+    VkBindImageMemoryInfo bind_info = init_bind_image_memory_info(
+        out_image->handle, out_image->alloc.memory, out_image->alloc.offset);
     VK_CHECK(vkBindImageMemory2(state->device.handle, 1, &bind_info));
 
     VkImageViewCreateInfo view_info = init_image_view2D_create_info(
         format, out_image->handle, aspect_flags);
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    view_info.subresourceRange.layerCount = layer_count;
     VK_CHECK(vkCreateImageView(state->device.handle, &view_info, state->allocator, &out_image->view));
 
     out_image->extent = extent;
@@ -68,27 +110,9 @@ void image2D_create_data(
     VkImageUsageFlags usage_flags,
     VkImageAspectFlags aspect_flags,
     VkMemoryPropertyFlags memory_flags,
+    gpu_memory_tag tag,
     image* out_image
 ) {
-    u64 data_size = extent.width * extent.height * extent.depth * 4;
-    buffer staging = {0};
-    buffer_create(
-        state,
-        data_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging);
-    void* mapped_memory;
-    vkMapMemory(
-        state->device.handle,
-        staging.memory,
-        /* offset: */ 0,
-        data_size,
-        /* flags: */ 0,
-        &mapped_memory);
-    etcopy_memory(mapped_memory, data, data_size);
-    vkUnmapMemory(state->device.handle, staging.memory);
-
     // Create image to upload data to
     image2D_create(
         state,
@@ -97,48 +121,12 @@ void image2D_create_data(
         usage_flags | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
         aspect_flags,
         memory_flags,
+        tag,
         out_image
     );
-    
-    IMMEDIATE_SUBMIT(state, cmd, {
-        // Transition image to optimal transfer destination layout
-        image_barrier(cmd, out_image->handle, out_image->aspects,
-            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT,
-            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT
-        );
-
-        VkBufferImageCopy2 cpy = init_buffer_image_copy2();
-        cpy.bufferOffset = 0;
-        cpy.bufferRowLength = 0;
-        cpy.bufferImageHeight = 0;
-
-        cpy.imageSubresource.aspectMask = out_image->aspects;
-        cpy.imageSubresource.mipLevel = 0;
-        cpy.imageSubresource.baseArrayLayer = 0;
-        cpy.imageSubresource.layerCount = 1;
-        cpy.imageOffset.x = 0;
-        cpy.imageOffset.y = 0;
-        cpy.imageOffset.z = 0;
-        cpy.imageExtent = extent;
-
-        VkCopyBufferToImageInfo2 copy_info = init_copy_buffer_to_image_info2(
-            staging.handle,
-            out_image->handle,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copy_info.regionCount = 1;
-        copy_info.pRegions = &cpy;
-
-        vkCmdCopyBufferToImage2(cmd, &copy_info);
-
-        // Transition image to shader readonly optimal for now
-        image_barrier(cmd, out_image->handle, out_image->aspects,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
-        );
-    });
-    buffer_destroy(state, &staging);
+
+    staging_upload_image2D(state, out_image, data, /* Texel size: */ 4);
+    staging_flush(state);
 }
 
 void image_destroy(renderer_state* state, image* image) {
@@ -149,10 +137,9 @@ void image_destroy(renderer_state* state, image* image) {
     image->aspects = VK_IMAGE_ASPECT_NONE;
 
     vkDestroyImageView(state->device.handle, image->view, state->allocator);
-    vkFreeMemory(state->device.handle, image->memory, state->allocator);
     vkDestroyImage(state->device.handle, image->handle, state->allocator);
+    gpu_memory_free(state, &image->alloc);
     image->view = 0;
-    image->memory = 0;
     image->handle = 0;
 }
 
@@ -216,7 +203,7 @@ void image_barrier(
         .baseMipLevel = 0,
         .levelCount = 1,
         .baseArrayLayer = 0,
-        .layerCount = 1};
+        .layerCount = VK_REMAINING_ARRAY_LAYERS};
     VkImageMemoryBarrier2 barrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
         .pNext = 0,
@@ -9,6 +9,19 @@ void image2D_create(
     VkImageUsageFlags usage_flags,
     VkImageAspectFlags aspect_flags,
     VkMemoryPropertyFlags memory_flags,
+    gpu_memory_tag tag,
+    image* out_image);
+
+// 2D array image with a VK_IMAGE_VIEW_TYPE_2D_ARRAY view of every layer
+void image2D_array_create(
+    renderer_state* state,
+    VkExtent3D extent,
+    u32 layer_count,
+    VkFormat format,
+    VkImageUsageFlags usage_flags,
+    VkImageAspectFlags aspect_flags,
+    VkMemoryPropertyFlags memory_flags,
+    gpu_memory_tag tag,
     image* out_image);
 
 void image2D_create_data(
@@ -19,6 +32,7 @@ void image2D_create_data(
     VkImageUsageFlags usage_flags,
     VkImageAspectFlags aspect_flags,
     VkMemoryPropertyFlags memory_flags,
+    gpu_memory_tag tag,
     image* out_image);
 
 void image_destroy(renderer_state* state, image* image);
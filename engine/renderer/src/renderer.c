@@ -18,6 +18,8 @@
 #include "renderer/src/pipeline.h"
 #include "renderer/src/shader.h"
 #include "renderer/src/descriptor.h"
+#include "renderer/src/gpu_memory.h"
+#include "renderer/src/staging.h"
 
 #include "window/renderer_window.h"
 
@@ -174,6 +176,11 @@ b8 renderer_initialize(renderer_state** out_state, renderer_config config) {
         return false;
     }
 
+    if (!gpu_allocator_initialize(state, &state->gpu_allocator)) {
+        ETFATAL("Error initializing gpu memory allocator.");
+        return false;
+    }
+
     // TODO: state->window_extent should be set before the swapchain in case the 
     // swapchain current extent is 0xFFFFFFFF. Special value to say the app is in
     // control of the size 
@@ -181,6 +188,11 @@ b8 renderer_initialize(renderer_state** out_state, renderer_config config) {
     
     initialize_immediate_submit(state);
 
+    if (!staging_ring_initialize(state, STAGING_RING_SIZE, &state->staging)) {
+        ETFATAL("Error initializing staging ring.");
+        return false;
+    }
+
     if (!initialize_default_data(state)) {
         ETFATAL("Error intializing data.");
         return false;
@@ -197,10 +209,15 @@ void renderer_shutdown(renderer_state* state) {
 
     shutdown_default_data(state);
 
+    staging_ring_shutdown(state, &state->staging);
+
     shutdown_immediate_submit(state);
 
     shutdown_swapchain(state, &state->swapchain);
 
+    gpu_memory_print_metrics(state);
+    gpu_allocator_shutdown(state, &state->gpu_allocator);
+
     device_destroy(state, &state->device);
     
 #ifdef _DEBUG
@@ -217,6 +234,14 @@ void renderer_shutdown(renderer_state* state) {
     etfree(state, sizeof(renderer_state), MEMORY_TAG_RENDERER);
 }
 
+void renderer_get_gpu_memory_stats(renderer_state* state, gpu_memory_stats* out_stats) {
+    gpu_memory_get_stats(state, out_stats);
+}
+
+void renderer_log_gpu_memory(renderer_state* state) {
+    gpu_memory_log_budget(state);
+}
+
 static void initialize_immediate_submit(renderer_state* state) {
     // Immediate command pool & buffer
     VkCommandPoolCreateInfo imm_pool_info = init_command_pool_create_info(
@@ -263,6 +288,7 @@ static b8 initialize_default_data(renderer_state* state) {
         VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_IMAGE_ASPECT_COLOR_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_TEXTURE,
         &state->default_white);
     ETINFO("White default image created.");
 
@@ -275,6 +301,7 @@ static b8 initialize_default_data(renderer_state* state) {
         VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_IMAGE_ASPECT_COLOR_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_TEXTURE,
         &state->default_grey);
     ETINFO("Grey default image created.");
 
@@ -287,6 +314,7 @@ static b8 initialize_default_data(renderer_state* state) {
         VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_IMAGE_ASPECT_COLOR_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_TEXTURE,
         &state->default_black);
     ETINFO("Black default image created.");
 
@@ -299,6 +327,7 @@ static b8 initialize_default_data(renderer_state* state) {
         VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_IMAGE_ASPECT_COLOR_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_TEXTURE,
         &state->default_normal);
     ETINFO("Normal default image created.");
 
@@ -317,6 +346,7 @@ static b8 initialize_default_data(renderer_state* state) {
         VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_IMAGE_ASPECT_COLOR_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_TEXTURE,
         &state->default_error);
     ETINFO("Checkerboard default image created.");
 
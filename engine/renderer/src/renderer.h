@@ -4,6 +4,8 @@
 #include "renderer/src/vk_types.h"
 #include "renderer/src/swapchain.h"
 #include "renderer/src/shader.h"
+#include "renderer/src/gpu_memory.h"
+#include "renderer/src/staging.h"
 
 typedef struct renderer_state {
     VkInstance instance;
@@ -15,6 +17,9 @@ typedef struct renderer_state {
 
     device device;
 
+    // NOTE: Sub-allocates device memory for buffers & images
+    gpu_allocator gpu_allocator;
+
     // TODO: Move to window
     swapchain swapchain;
     // TODO: END
@@ -24,6 +29,9 @@ typedef struct renderer_state {
     VkCommandBuffer imm_buffer;
     VkFence imm_fence;
 
+    // NOTE: Persistently mapped staging memory for uploads
+    staging_ring staging;
+
     // NOTE: Defaults
     image default_white;
     image default_black;
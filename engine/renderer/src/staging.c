@@ -0,0 +1,678 @@
+#include "staging.h"
+
+#include "core/logger.h"
+#include "memory/etmemory.h"
+#include "data_structures/dynarray.h"
+
+#include "renderer/src/renderer.h"
+#include "renderer/src/buffer.h"
+#include "renderer/src/image.h"
+#include "renderer/src/utilities/vkinit.h"
+
+static VkCommandBuffer staging_begin(renderer_state* state);
+static VkCommandBuffer staging_reserve(renderer_state* state, u64 size, u64 alignment, u64* out_offset);
+static b8 staging_try_reserve(staging_ring* ring, u64 size, u64 alignment, u64* out_offset);
+static void staging_submit_recorded(renderer_state* state);
+static void staging_retire(renderer_state* state, b8 wait);
+
+static void upload_buffer(renderer_state* state, VkBuffer dst, u64 dst_offset, const void* data, u64 size, b8 reupload);
+static void upload_image2D(renderer_state* state, image* dst, const void* data, u32 texel_size, b8 reupload);
+
+static void staging_release_buffer(renderer_state* state, VkBuffer buffer, u64 offset, u64 size);
+static void staging_release_image(renderer_state* state, image* image);
+static VkCommandBuffer staging_graphics_release(renderer_state* state);
+static void staging_reclaim_buffer(renderer_state* state, VkBuffer buffer, u64 offset, u64 size);
+static void staging_reclaim_image(renderer_state* state, image* image);
+
+static inline u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+b8 staging_ring_initialize(renderer_state* state, u64 size, staging_ring* ring) {
+    etzero_memory(ring, sizeof(staging_ring));
+
+    buffer_create(
+        state,
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        GPU_MEMORY_TAG_STAGING,
+        &ring->buffer);
+    if (!ring->buffer.alloc.mapped) {
+        ETERROR("Staging ring memory is not host visible.");
+        return false;
+    }
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, ring->buffer.handle, "StagingRingBuffer");
+    ring->mapped = ring->buffer.alloc.mapped;
+    ring->size = size;
+
+    VkCommandPoolCreateInfo pool_info = init_command_pool_create_info(
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        state->device.transfer_qfi);
+    VK_CHECK(vkCreateCommandPool(state->device.handle, &pool_info, state->allocator, &ring->pool));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_COMMAND_POOL, ring->pool, "StagingRingCommandPool");
+
+    VkCommandBuffer cmds[STAGING_RING_MAX_SUBMITS];
+    VkCommandBufferAllocateInfo cmd_alloc_info = init_command_buffer_allocate_info(
+        ring->pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, STAGING_RING_MAX_SUBMITS);
+    VK_CHECK(vkAllocateCommandBuffers(state->device.handle, &cmd_alloc_info, cmds));
+    for (u32 i = 0; i < STAGING_RING_MAX_SUBMITS; ++i) {
+        ring->submits[i].cmd = cmds[i];
+    }
+
+    VkSemaphoreTypeCreateInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = 0,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo semaphore_info = init_semaphore_create_info(/* Flags: */ 0);
+    semaphore_info.pNext = &timeline_info;
+    VK_CHECK(vkCreateSemaphore(state->device.handle, &semaphore_info, state->allocator, &ring->timeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_SEMAPHORE, ring->timeline, "StagingRingTimeline");
+
+    ring->ownership_transfer = state->device.transfer_qfi != state->device.graphics_qfi;
+    ring->buffer_acquires = dynarray_create(1, sizeof(VkBufferMemoryBarrier2));
+    ring->image_acquires = dynarray_create(1, sizeof(VkImageMemoryBarrier2));
+
+    VkCommandPoolCreateInfo acquire_pool_info = init_command_pool_create_info(
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        state->device.graphics_qfi);
+    VK_CHECK(vkCreateCommandPool(state->device.handle, &acquire_pool_info, state->allocator, &ring->acquire_pool));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_COMMAND_POOL, ring->acquire_pool, "StagingAcquireCommandPool");
+
+    VkCommandBufferAllocateInfo acquire_alloc_info = init_command_buffer_allocate_info(
+        ring->acquire_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+    VK_CHECK(vkAllocateCommandBuffers(state->device.handle, &acquire_alloc_info, &ring->acquire_cmd));
+
+    VkFenceCreateInfo fence_info = init_fence_create_info(/* Flags: */ 0);
+    VK_CHECK(vkCreateFence(state->device.handle, &fence_info, state->allocator, &ring->acquire_fence));
+
+    VkCommandBufferAllocateInfo release_alloc_info = init_command_buffer_allocate_info(
+        ring->acquire_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+    VK_CHECK(vkAllocateCommandBuffers(state->device.handle, &release_alloc_info, &ring->release_cmd));
+
+    VkSemaphoreCreateInfo release_semaphore_info = init_semaphore_create_info(/* Flags: */ 0);
+    release_semaphore_info.pNext = &timeline_info;
+    VK_CHECK(vkCreateSemaphore(state->device.handle, &release_semaphore_info, state->allocator, &ring->release_timeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_SEMAPHORE, ring->release_timeline, "StagingReleaseTimeline");
+
+    ETINFO("Staging ring initialized%s.", ring->ownership_transfer ? " on dedicated transfer queue" : "");
+    return true;
+}
+
+void staging_ring_shutdown(renderer_state* state, staging_ring* ring) {
+    staging_wait_idle(state);
+
+    vkDestroySemaphore(state->device.handle, ring->release_timeline, state->allocator);
+    vkDestroyFence(state->device.handle, ring->acquire_fence, state->allocator);
+    vkDestroyCommandPool(state->device.handle, ring->acquire_pool, state->allocator);
+    dynarray_destroy(ring->image_acquires);
+    dynarray_destroy(ring->buffer_acquires);
+
+    vkDestroySemaphore(state->device.handle, ring->timeline, state->allocator);
+    vkDestroyCommandPool(state->device.handle, ring->pool, state->allocator);
+    buffer_destroy(state, &ring->buffer);
+    ETINFO("Staging ring shutdown.");
+}
+
+void staging_upload_buffer(
+    renderer_state* state,
+    VkBuffer dst,
+    u64 dst_offset,
+    const void* data,
+    u64 size
+) {
+    upload_buffer(state, dst, dst_offset, data, size, /* reupload: */ false);
+}
+
+void staging_upload_image2D(
+    renderer_state* state,
+    image* dst,
+    const void* data,
+    u32 texel_size
+) {
+    upload_image2D(state, dst, data, texel_size, /* reupload: */ false);
+}
+
+void staging_reupload_buffer(
+    renderer_state* state,
+    VkBuffer dst,
+    u64 dst_offset,
+    const void* data,
+    u64 size
+) {
+    upload_buffer(state, dst, dst_offset, data, size, /* reupload: */ true);
+}
+
+void staging_reupload_image2D(
+    renderer_state* state,
+    image* dst,
+    const void* data,
+    u32 texel_size
+) {
+    upload_image2D(state, dst, data, texel_size, /* reupload: */ true);
+}
+
+static void upload_buffer(renderer_state* state, VkBuffer dst, u64 dst_offset, const void* data, u64 size, b8 reupload) {
+    staging_ring* ring = &state->staging;
+    const u64 max_chunk = ring->size / 4;
+
+    if (reupload) {
+        staging_reclaim_buffer(state, dst, dst_offset, size);
+    }
+
+    u64 copied = 0;
+    while (copied < size) {
+        u64 chunk = size - copied;
+        chunk = (chunk > max_chunk) ? max_chunk : chunk;
+
+        u64 offset;
+        VkCommandBuffer cmd = staging_reserve(state, chunk, 16, &offset);
+        etcopy_memory(ring->mapped + offset, (const u8*)data + copied, chunk);
+
+        VkBufferCopy buffer_copy = {
+            .srcOffset = offset,
+            .dstOffset = dst_offset + copied,
+            .size = chunk};
+        vkCmdCopyBuffer(cmd, ring->buffer.handle, dst, 1, &buffer_copy);
+        copied += chunk;
+    }
+
+    if (ring->ownership_transfer) {
+        staging_release_buffer(state, dst, dst_offset, size);
+    }
+}
+
+static void upload_image2D(renderer_state* state, image* dst, const void* data, u32 texel_size, b8 reupload) {
+    staging_ring* ring = &state->staging;
+    const u64 row_size = (u64)dst->extent.width * texel_size;
+    ETASSERT(row_size <= ring->size / 4);
+
+    u64 alignment = state->device.gpu_limits.optimalBufferCopyOffsetAlignment;
+    alignment = (alignment < 16) ? 16 : alignment;
+
+    if (reupload && ring->ownership_transfer) {
+        // The acquire from the graphics queue family transitions the image
+        staging_reclaim_image(state, dst);
+    } else {
+        if (reupload) {
+            staging_graphics_release(state);
+        }
+        // Transition image to optimal transfer destination layout
+        image_barrier(staging_begin(state), dst->handle, dst->aspects,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT
+        );
+    }
+
+    // NOTE: Rows reach the edges of the image, so only their offset & height have to be
+    // multiples of the transfer granularity. A zero granularity only allows whole image copies
+    VkExtent3D granularity = state->device.transfer_image_granularity;
+    u32 max_rows = (u32)((ring->size / 4) / row_size);
+    if (granularity.height == 0) {
+        max_rows = dst->extent.height;
+        ETASSERT(row_size * max_rows <= ring->size);
+    } else if (max_rows >= granularity.height) {
+        max_rows -= max_rows % granularity.height;
+    } else {
+        max_rows = granularity.height;
+    }
+    u32 rows_copied = 0;
+    while (rows_copied < dst->extent.height) {
+        u32 rows = dst->extent.height - rows_copied;
+        rows = (rows > max_rows) ? max_rows : rows;
+        u64 chunk = row_size * rows;
+
+        u64 offset;
+        VkCommandBuffer cmd = staging_reserve(state, chunk, alignment, &offset);
+        etcopy_memory(ring->mapped + offset, (const u8*)data + row_size * rows_copied, chunk);
+
+        VkBufferImageCopy2 cpy = init_buffer_image_copy2();
+        cpy.bufferOffset = offset;
+        cpy.bufferRowLength = 0;
+        cpy.bufferImageHeight = 0;
+
+        cpy.imageSubresource.aspectMask = dst->aspects;
+        cpy.imageSubresource.mipLevel = 0;
+        cpy.imageSubresource.baseArrayLayer = 0;
+        cpy.imageSubresource.layerCount = 1;
+        cpy.imageOffset.x = 0;
+        cpy.imageOffset.y = rows_copied;
+        cpy.imageOffset.z = 0;
+        cpy.imageExtent.width = dst->extent.width;
+        cpy.imageExtent.height = rows;
+        cpy.imageExtent.depth = 1;
+
+        VkCopyBufferToImageInfo2 copy_info = init_copy_buffer_to_image_info2(
+            ring->buffer.handle,
+            dst->handle,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        copy_info.regionCount = 1;
+        copy_info.pRegions = &cpy;
+        vkCmdCopyBufferToImage2(cmd, &copy_info);
+
+        rows_copied += rows;
+    }
+
+    if (ring->ownership_transfer) {
+        staging_release_image(state, dst);
+        return;
+    }
+
+    // Transition image to shader readonly optimal for now
+    image_barrier(staging_begin(state), dst->handle, dst->aspects,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+    );
+}
+
+void staging_flush(renderer_state* state) {
+    if (state->staging.batch_depth) {
+        return;
+    }
+    staging_submit_recorded(state);
+}
+
+u64 staging_acquire(renderer_state* state, VkCommandBuffer cmd) {
+    staging_ring* ring = &state->staging;
+    staging_submit_recorded(state);
+
+    u32 buffer_acquire_count = dynarray_length(ring->buffer_acquires);
+    u32 image_acquire_count = dynarray_length(ring->image_acquires);
+    if (buffer_acquire_count || image_acquire_count) {
+        VkDependencyInfo dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = 0,
+            .bufferMemoryBarrierCount = buffer_acquire_count,
+            .pBufferMemoryBarriers = ring->buffer_acquires,
+            .imageMemoryBarrierCount = image_acquire_count,
+            .pImageMemoryBarriers = ring->image_acquires,
+        };
+        vkCmdPipelineBarrier2(cmd, &dependency);
+        dynarray_clear(ring->buffer_acquires);
+        dynarray_clear(ring->image_acquires);
+    }
+
+    if (ring->acquired_value == ring->timeline_value) {
+        return 0;
+    }
+    ring->acquired_value = ring->timeline_value;
+    return ring->acquired_value;
+}
+
+void staging_batch_begin(renderer_state* state) {
+    state->staging.batch_depth++;
+}
+
+void staging_batch_end(renderer_state* state) {
+    staging_ring* ring = &state->staging;
+    ETASSERT(ring->batch_depth);
+    if (--ring->batch_depth) {
+        return;
+    }
+
+    VK_CHECK(vkResetCommandBuffer(ring->acquire_cmd, 0));
+    VkCommandBufferBeginInfo cmd_begin = init_command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(ring->acquire_cmd, &cmd_begin));
+    u64 wait_value = staging_acquire(state, ring->acquire_cmd);
+    VK_CHECK(vkEndCommandBuffer(ring->acquire_cmd));
+
+    if (wait_value) {
+        VkSemaphoreSubmitInfo wait_submit = init_semaphore_submit_info(
+            ring->timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+        wait_submit.value = wait_value;
+        VkCommandBufferSubmitInfo cmd_submit = init_command_buffer_submit_info(ring->acquire_cmd);
+        VkSubmitInfo2 submit_info = init_submit_info2(1, &wait_submit, 1, &cmd_submit, 0, NULL);
+
+        VK_CHECK(vkResetFences(state->device.handle, 1, &ring->acquire_fence));
+        VK_CHECK(vkQueueSubmit2(state->device.graphics_queue, 1, &submit_info, ring->acquire_fence));
+        VK_CHECK(vkWaitForFences(state->device.handle, 1, &ring->acquire_fence, VK_TRUE, 0xFFFFFFFFFFFFFFFF));
+    }
+
+    // The acquire waited on every submission so none of these block
+    while (ring->submit_count) {
+        staging_retire(state, true);
+    }
+}
+
+void staging_wait_idle(renderer_state* state) {
+    staging_submit_recorded(state);
+    while (state->staging.submit_count) {
+        staging_retire(state, true);
+    }
+}
+
+static void staging_submit_recorded(renderer_state* state) {
+    staging_ring* ring = &state->staging;
+    if (ring->cmd == VK_NULL_HANDLE) {
+        return;
+    }
+    VK_CHECK(vkEndCommandBuffer(ring->cmd));
+
+    // The graphics queue releases re-uploaded resources after the work submitted before them
+    VkSemaphoreSubmitInfo release_wait = init_semaphore_submit_info(
+        ring->release_timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    u32 wait_count = 0;
+    if (ring->release_pending) {
+        VkCommandBufferSubmitInfo release_info = init_command_buffer_submit_info(ring->release_cmd);
+        u32 release_count = 0;
+        if (ring->release_recording) {
+            VK_CHECK(vkEndCommandBuffer(ring->release_cmd));
+            release_count = 1;
+        }
+        VkSemaphoreSubmitInfo release_signal = release_wait;
+        release_signal.value = ++ring->release_value;
+        VkSubmitInfo2 release_submit = init_submit_info2(0, NULL, release_count, &release_info, 1, &release_signal);
+        VK_CHECK(vkQueueSubmit2(state->device.graphics_queue, 1, &release_submit, VK_NULL_HANDLE));
+
+        release_wait.value = ring->release_value;
+        wait_count = 1;
+        ring->release_pending = false;
+        ring->release_recording = false;
+    }
+
+    u32 slot = (ring->first_submit + ring->submit_count) % STAGING_RING_MAX_SUBMITS;
+    staging_submit* submit = &ring->submits[slot];
+    submit->value = ++ring->timeline_value;
+
+    // NOTE: The semaphore signal makes the transfer writes available, the waiting
+    // graphics submission makes them visible. So no trailing barrier is needed
+    VkCommandBufferSubmitInfo cmd_info = init_command_buffer_submit_info(ring->cmd);
+    VkSemaphoreSubmitInfo signal_info = init_semaphore_submit_info(
+        ring->timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    signal_info.value = submit->value;
+    VkSubmitInfo2 submit_info = init_submit_info2(wait_count, &release_wait, 1, &cmd_info, 1, &signal_info);
+    VK_CHECK(vkQueueSubmit2(state->device.transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+
+    submit->end = ring->head;
+    submit->bytes = ring->recording_bytes;
+    ring->submit_count++;
+
+    ring->cmd = VK_NULL_HANDLE;
+    ring->recording_bytes = 0;
+}
+
+// Returns the command buffer being recorded, starting a new submission when there isn't one
+static VkCommandBuffer staging_begin(renderer_state* state) {
+    staging_ring* ring = &state->staging;
+    if (ring->cmd != VK_NULL_HANDLE) {
+        return ring->cmd;
+    }
+
+    // Reclaim completed submissions without blocking
+    if (ring->submit_count) {
+        u64 completed = 0;
+        VK_CHECK(vkGetSemaphoreCounterValue(state->device.handle, ring->timeline, &completed));
+        while (ring->submit_count && ring->submits[ring->first_submit].value <= completed) {
+            staging_retire(state, false);
+        }
+    }
+    if (ring->submit_count == STAGING_RING_MAX_SUBMITS) {
+        staging_retire(state, true);
+    }
+
+    u32 slot = (ring->first_submit + ring->submit_count) % STAGING_RING_MAX_SUBMITS;
+    ring->cmd = ring->submits[slot].cmd;
+
+    VK_CHECK(vkResetCommandBuffer(ring->cmd, 0));
+    VkCommandBufferBeginInfo cmd_begin = init_command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(ring->cmd, &cmd_begin));
+    return ring->cmd;
+}
+
+// NOTE: Can submit the command buffer being recorded to make space, so the returned
+// command buffer must be used for the commands that read from the reserved range
+static VkCommandBuffer staging_reserve(renderer_state* state, u64 size, u64 alignment, u64* out_offset) {
+    staging_ring* ring = &state->staging;
+    ETASSERT(size <= ring->size);
+
+    staging_begin(state);
+    while (!staging_try_reserve(ring, size, alignment, out_offset)) {
+        if (ring->submit_count) {
+            staging_retire(state, true);
+        } else {
+            // Only the submission being recorded holds ring space
+            staging_submit_recorded(state);
+            staging_begin(state);
+        }
+    }
+    return ring->cmd;
+}
+
+static b8 staging_try_reserve(staging_ring* ring, u64 size, u64 alignment, u64* out_offset) {
+    if (ring->used == 0) {
+        ring->head = 0;
+        ring->tail = 0;
+    }
+
+    u64 start = align_up(ring->head, alignment);
+    u64 consumed = 0;
+    if (ring->head >= ring->tail) {
+        // Full ring when head has caught up with tail
+        if (ring->used && ring->head == ring->tail) {
+            return false;
+        }
+        if (start + size <= ring->size) {
+            consumed = (start - ring->head) + size;
+        } else if (size <= ring->tail) {
+            // Wrap around, the end of the ring is wasted until the tail passes it
+            start = 0;
+            consumed = (ring->size - ring->head) + size;
+        } else {
+            return false;
+        }
+    } else {
+        if (start + size > ring->tail) {
+            return false;
+        }
+        consumed = (start - ring->head) + size;
+    }
+
+    ring->head = (start + size == ring->size) ? 0 : start + size;
+    ring->used += consumed;
+    ring->recording_bytes += consumed;
+    *out_offset = start;
+    return true;
+}
+
+static void staging_retire(renderer_state* state, b8 wait) {
+    staging_ring* ring = &state->staging;
+    ETASSERT(ring->submit_count);
+
+    staging_submit* submit = &ring->submits[ring->first_submit];
+    if (wait) {
+        VkSemaphoreWaitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &ring->timeline,
+            .pValues = &submit->value,
+        };
+        VK_CHECK(vkWaitSemaphores(state->device.handle, &wait_info, 0xFFFFFFFFFFFFFFFF));
+    }
+
+    ring->tail = submit->end;
+    ring->used -= submit->bytes;
+    ring->first_submit = (ring->first_submit + 1) % STAGING_RING_MAX_SUBMITS;
+    ring->submit_count--;
+}
+
+static void staging_release_buffer(renderer_state* state, VkBuffer buffer, u64 offset, u64 size) {
+    staging_ring* ring = &state->staging;
+    VkBufferMemoryBarrier2 release = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .srcQueueFamilyIndex = state->device.transfer_qfi,
+        .dstQueueFamilyIndex = state->device.graphics_qfi,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers = &release,
+    };
+    vkCmdPipelineBarrier2(staging_begin(state), &dependency);
+
+    VkBufferMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    acquire.srcAccessMask = VK_ACCESS_2_NONE;
+    acquire.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    acquire.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    dynarray_push((void**)&ring->buffer_acquires, &acquire);
+}
+
+static void staging_release_image(renderer_state* state, image* image) {
+    staging_ring* ring = &state->staging;
+    VkImageMemoryBarrier2 release = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = state->device.transfer_qfi,
+        .dstQueueFamilyIndex = state->device.graphics_qfi,
+        .image = image->handle,
+        .subresourceRange = {
+            .aspectMask = image->aspects,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &release,
+    };
+    vkCmdPipelineBarrier2(staging_begin(state), &dependency);
+
+    VkImageMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    acquire.srcAccessMask = VK_ACCESS_2_NONE;
+    acquire.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    acquire.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+    dynarray_push((void**)&ring->image_acquires, &acquire);
+}
+
+// Returns the graphics queue family command buffer releasing resources to the transfer queue
+// family. The submission being recorded waits on its submission, which is also ordered after
+// the graphics work submitted before it
+static VkCommandBuffer staging_graphics_release(renderer_state* state) {
+    staging_ring* ring = &state->staging;
+    ring->release_pending = true;
+    // NOTE: Without an ownership transfer there is nothing to record, the submission alone
+    // orders the copies after the graphics work
+    if (!ring->ownership_transfer || ring->release_recording) {
+        return ring->release_cmd;
+    }
+
+    // The previous release has to complete before its command buffer is reused
+    if (ring->release_value) {
+        VkSemaphoreWaitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &ring->release_timeline,
+            .pValues = &ring->release_value,
+        };
+        VK_CHECK(vkWaitSemaphores(state->device.handle, &wait_info, 0xFFFFFFFFFFFFFFFF));
+    }
+    VK_CHECK(vkResetCommandBuffer(ring->release_cmd, 0));
+    VkCommandBufferBeginInfo cmd_begin = init_command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(ring->release_cmd, &cmd_begin));
+    ring->release_recording = true;
+    return ring->release_cmd;
+}
+
+// Releases a buffer range the graphics queue family owns & acquires it for the copies that follow
+static void staging_reclaim_buffer(renderer_state* state, VkBuffer buffer, u64 offset, u64 size) {
+    staging_ring* ring = &state->staging;
+    VkCommandBuffer release_cmd = staging_graphics_release(state);
+    if (!ring->ownership_transfer) {
+        return;
+    }
+
+    VkBufferMemoryBarrier2 release = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .srcQueueFamilyIndex = state->device.graphics_qfi,
+        .dstQueueFamilyIndex = state->device.transfer_qfi,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers = &release,
+    };
+    vkCmdPipelineBarrier2(release_cmd, &dependency);
+
+    VkBufferMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    acquire.srcAccessMask = VK_ACCESS_2_NONE;
+    acquire.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    acquire.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    dependency.pBufferMemoryBarriers = &acquire;
+    vkCmdPipelineBarrier2(staging_begin(state), &dependency);
+}
+
+// Releases an image the graphics queue family owns & acquires it in the transfer destination layout
+static void staging_reclaim_image(renderer_state* state, image* image) {
+    VkImageMemoryBarrier2 release = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = state->device.graphics_qfi,
+        .dstQueueFamilyIndex = state->device.transfer_qfi,
+        .image = image->handle,
+        .subresourceRange = {
+            .aspectMask = image->aspects,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &release,
+    };
+    vkCmdPipelineBarrier2(staging_graphics_release(state), &dependency);
+
+    VkImageMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    acquire.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    acquire.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    dependency.pImageMemoryBarriers = &acquire;
+    vkCmdPipelineBarrier2(staging_begin(state), &dependency);
+}
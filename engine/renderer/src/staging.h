@@ -0,0 +1,144 @@
+#pragma once
+
+#include "renderer/src/vk_types.h"
+
+/** NOTE: Staging ring
+ * A single persistently mapped host visible buffer that all uploads are written into.
+ * Upload functions copy the source data into the ring and record the copy commands
+ * into the ring's current command buffer. staging_flush submits the recorded commands
+ * to the transfer queue without waiting, each submission signals the ring's timeline
+ * semaphore and the ring space it used is reclaimed once the semaphore reaches its value.
+ * The host only blocks when the ring is out of space or on staging_wait_idle.
+ *
+ * Uploads larger than a quarter of the ring are split into multiple copies, so any
+ * upload fits as long as a single row of an image does.
+ *
+ * When the transfer queue is from a different queue family than the graphics queue the
+ * uploaded resources are released by the transfer queue and the matching acquire
+ * barriers are kept pending. staging_acquire records the pending acquires into a graphics
+ * command buffer, that command buffer's submission has to wait on the ring's timeline
+ * semaphore for the value returned. This lets uploads overlap rendering, the graphics
+ * queue only waits at the point the uploaded resources are first used.
+ *
+ * Re-uploads into resources the graphics queue has already used go through the staging_reupload
+ * functions. The graphics queue releases them back to the transfer queue family in a submission
+ * that signals the release timeline semaphore, and the transfer submission acquiring them waits
+ * on it. So the copies also wait on the graphics work that used the resources before.
+ *
+ * Image copies respect the transfer queue family's minImageTransferGranularity, rows are split
+ * at multiples of its height & a zero granularity copies the whole image at once.
+ *
+ * Between staging_batch_begin & staging_batch_end staging_flush does nothing, so all
+ * uploads are recorded into as few command buffers as the ring size allows and the host
+ * waits once at staging_batch_end. Batches can be nested.
+ */
+
+#define STAGING_RING_SIZE (64ull * 1024 * 1024)
+#define STAGING_RING_MAX_SUBMITS 16
+
+typedef struct staging_submit {
+    VkCommandBuffer cmd;
+    // Timeline semaphore value signaled on completion
+    u64 value;
+    // Ring head at the time of submission
+    u64 end;
+    // Ring bytes consumed by the submission, including wrap around padding
+    u64 bytes;
+} staging_submit;
+
+typedef struct staging_ring {
+    buffer buffer;
+    u8* mapped;
+    u64 size;
+
+    u64 head;
+    u64 tail;
+    u64 used;
+
+    // Transfer queue family command pool
+    VkCommandPool pool;
+    staging_submit submits[STAGING_RING_MAX_SUBMITS];
+    // Oldest in flight submission & in flight submission count
+    u32 first_submit;
+    u32 submit_count;
+
+    VkSemaphore timeline;
+    u64 timeline_value;
+    // Last timeline value handed out by staging_acquire
+    u64 acquired_value;
+
+    // Submission being recorded, VK_NULL_HANDLE when nothing is being recorded
+    VkCommandBuffer cmd;
+    u64 recording_bytes;
+
+    // Queue family ownership transfer from the transfer to the graphics queue family
+    b8 ownership_transfer;
+    VkBufferMemoryBarrier2* buffer_acquires;    // Dynarray
+    VkImageMemoryBarrier2* image_acquires;      // Dynarray
+
+    // Graphics queue family command buffer for acquiring a batch
+    VkCommandPool acquire_pool;
+    VkCommandBuffer acquire_cmd;
+    VkFence acquire_fence;
+
+    // Graphics queue family command buffer releasing re-uploaded resources to the transfer queue family
+    VkCommandBuffer release_cmd;
+    b8 release_recording;
+    // The submission being recorded waits on a graphics queue release
+    b8 release_pending;
+    VkSemaphore release_timeline;
+    u64 release_value;
+
+    u32 batch_depth;
+} staging_ring;
+
+b8 staging_ring_initialize(renderer_state* state, u64 size, staging_ring* ring);
+
+void staging_ring_shutdown(renderer_state* state, staging_ring* ring);
+
+void staging_upload_buffer(
+    renderer_state* state,
+    VkBuffer dst,
+    u64 dst_offset,
+    const void* data,
+    u64 size);
+
+// NOTE: Transitions the image from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+void staging_upload_image2D(
+    renderer_state* state,
+    image* dst,
+    const void* data,
+    u32 texel_size);
+
+// Uploads into a buffer range the graphics queue has already used
+void staging_reupload_buffer(
+    renderer_state* state,
+    VkBuffer dst,
+    u64 dst_offset,
+    const void* data,
+    u64 size);
+
+// Uploads into an image the graphics queue has already used, it must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+void staging_reupload_image2D(
+    renderer_state* state,
+    image* dst,
+    const void* data,
+    u32 texel_size);
+
+// Submits recorded uploads without waiting on them. Does nothing inside of a batch
+void staging_flush(renderer_state* state);
+
+/**
+ * Submits recorded uploads and records the pending acquire barriers into cmd, which must
+ * be a graphics queue command buffer. Returns the timeline value the submission of cmd
+ * must wait on for the ring's timeline semaphore, 0 when there is nothing to wait on.
+ */
+u64 staging_acquire(renderer_state* state, VkCommandBuffer cmd);
+
+void staging_batch_begin(renderer_state* state);
+
+// Submits the batch, acquires it on the graphics queue & waits for it to complete
+void staging_batch_end(renderer_state* state);
+
+// Submits recorded uploads and waits for every in flight upload to complete
+void staging_wait_idle(renderer_state* state);
@@ -6,6 +6,7 @@
 
 #include "renderer/src/renderer.h"
 #include "renderer/src/buffer.h"
+#include "renderer/src/staging.h"
 
 /** TODO:
  * Documentation explaining what this does and how it works
@@ -70,10 +71,8 @@ void _immediate_end(renderer_state* state) {
     VK_CHECK(vkWaitForFences(state->device.handle, 1, &state->imm_fence, VK_TRUE, 0xFFFFFFFFFFFFFFFF));
 }
 
-// TODO: Remove the VK_MEMORY_PROPERTY_HOST_COHERENT_BIT bit from the staging buffer and flush manually
-// TODO: Use queue from dedicated transfer queue family(state->device.transfer_queue) to do transfers
-mesh_buffers upload_mesh_immediate(renderer_state* state, u32 index_count, u32* indices, u32 vertex_count, vertex* vertices) {
-    const u64 vertex_buffer_size = vertex_count * sizeof(vertex);
+mesh_buffers upload_mesh_immediate(renderer_state* state, u32 index_count, u32* indices, u32 vertex_count, packed_position* positions) {
+    const u64 vertex_buffer_size = vertex_count * sizeof(packed_position);
     const u64 index_buffer_size = index_count * sizeof(u32);
 
     mesh_buffers new_surface;
@@ -86,6 +85,7 @@ mesh_buffers upload_mesh_immediate(renderer_state* state, u32 index_count, u32*
         | VK_BUFFER_USAGE_TRANSFER_DST_BIT
         | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
         &new_surface.vertex_buffer
     );
     // Create Index Buffer
@@ -94,43 +94,13 @@ mesh_buffers upload_mesh_immediate(renderer_state* state, u32 index_count, u32*
         index_buffer_size,
         VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
         &new_surface.index_buffer
     );
     
-    // Create staging buffer to transfer memory from VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT to VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    buffer staging;
-    buffer_create(
-        state,
-        vertex_buffer_size + index_buffer_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging
-    );
-    void* mapped_memory;
-    vkMapMemory(state->device.handle, staging.memory, 0, vertex_buffer_size + index_buffer_size, 0, &mapped_memory);
-
-    etcopy_memory(mapped_memory, vertices, vertex_buffer_size);
-    etcopy_memory((u8*)mapped_memory + vertex_buffer_size, indices, index_buffer_size);
-
-    vkUnmapMemory(state->device.handle, staging.memory);
-
-    IMMEDIATE_SUBMIT(state, cmd, {
-        VkBufferCopy vertex_copy = {
-            .dstOffset = 0,
-            .srcOffset = 0,
-            .size = vertex_buffer_size};
-
-        vkCmdCopyBuffer(cmd, staging.handle, new_surface.vertex_buffer.handle, 1, &vertex_copy);
-
-        VkBufferCopy index_copy = {
-            .dstOffset = 0,
-            .srcOffset = vertex_buffer_size,
-            .size = index_buffer_size};
-
-        vkCmdCopyBuffer(cmd, staging.handle, new_surface.index_buffer.handle, 1, &index_copy);
-    });
-
-    buffer_destroy(state, &staging);
+    staging_upload_buffer(state, new_surface.vertex_buffer.handle, /* Offset: */ 0, positions, vertex_buffer_size);
+    staging_upload_buffer(state, new_surface.index_buffer.handle, /* Offset: */ 0, indices, index_buffer_size);
+    staging_flush(state);
 
     return new_surface;
 }
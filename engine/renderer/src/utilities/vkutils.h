@@ -46,4 +46,4 @@ do {                                            \
 mesh_buffers upload_mesh_immediate(
     renderer_state* state,
     u32 index_count, u32* indices, 
-    u32 vertex_count, vertex* vertices);
\ No newline at end of file
+    u32 vertex_count, packed_position* positions);
\ No newline at end of file
@@ -40,13 +40,30 @@ typedef struct descriptor_set_allocator {
 } ds_allocator;
 // TODO: END
 
+// NOTE: A sub-range of a device memory block owned by the gpu allocator (renderer/src/gpu_memory.h)
+typedef struct gpu_allocation {
+    VkDeviceMemory memory;
+    u64 offset;
+    u64 size;
+
+    // Null when the memory type is not host visible
+    void* mapped;
+
+    u32 memory_type;
+    // Allocated with VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT, from the memory type's device address pool
+    b8 device_address;
+    // INVALID_ID for dedicated allocations
+    u32 block_index;
+    gpu_memory_tag tag;
+} gpu_allocation;
+
 typedef struct image {
     u32 id;
     char* name;
 
     VkImage handle;
     VkImageView view;
-    VkDeviceMemory memory;
+    gpu_allocation alloc;
 
     VkExtent3D extent;
     VkImageType type;
@@ -58,7 +75,7 @@ typedef struct image {
 typedef struct buffer {
     u64 size;
     VkBuffer handle;
-    VkDeviceMemory memory;
+    gpu_allocation alloc;
 } buffer;
 
 // TEMP: Refactor this
@@ -75,9 +92,19 @@ typedef enum debug_view_type {
     DEBUG_VIEW_TYPE_MAX,
 } debug_view_type;
 
+// Filtering of the sun's shadow, PCF kernels are bilinearly weighted texel boxes.
+// NOTE: Must match input_structures.glsl
+typedef enum shadow_filter_type {
+    SHADOW_FILTER_PCF_3X3 = 0,
+    SHADOW_FILTER_PCF_5X5,
+    SHADOW_FILTER_PCF_7X7,
+    SHADOW_FILTER_PCSS,         // Kernel widens with the distance from the blocker to the receiver
+    SHADOW_FILTER_MAX,
+} shadow_filter_type;
+
 typedef struct point_light {
-	v4s color;
-	v4s position;
+	v4s color;      // rgb, a is the intensity
+	v4s position;   // xyz, w is the range past which the light is ignored
 } point_light;
 
 typedef struct direction_light {
@@ -85,33 +112,70 @@ typedef struct direction_light {
 	v4s direction;
 } direction_light;
 
+// NOTE: Must match input_structures.glsl
+#define MAX_SHADOW_CASCADES 4
+
 typedef struct scene_data {
     // Camera/View
     m4s view;
     m4s proj;
     m4s viewproj;
+    // viewproj of the frame the depth pyramid was built from
+    m4s pyramid_viewproj;
     v4s view_pos;
 
     // TEMP: Eventually define multiple lights
     v4s ambient_color;
-    point_light light;
 
-    m4s sun_viewproj;   // For shadow mapping
+    // Sun shadow cascades, each fitted to a slice of the camera frustum & rendered to a layer of the shadow map
+    m4s cascade_viewprojs[MAX_SHADOW_CASCADES];
+    v4s cascade_splits;     // View depth each cascade ends at
     direction_light sun;
     // TEMP: END
+
+    // World space frustum planes for culling, normals point inward
+    v4s frustum_planes[6];
+    v4s cascade_frustum_planes[MAX_SHADOW_CASCADES][6];  // Box each shadow cascade's casters are culled against
     
     // Kinda hacky spaghetti placement of this info
     float alpha_cutoff;
-    u32 max_draw_count;
+    u32 max_draw_count;     // Capacity of each index type's half of a draw buffer
     u32 shadow_draw_id;
     u32 shadow_map_id;
+    u32 shadow_compare_id;      // Same image as shadow_map_id through a comparison sampler
     u32 debug_view;
+
+    u32 object_count;
+    u32 instance_group_count;
+    u32 instance_level_count;   // Levels of detail across the instance groups
+    u32 pipe_count;         // Material pipelines, the shadow draw buffer slot follows them
+    u32 cluster_capacity;   // Length of the cluster list
+    // Index into the counts buffer of this frame's culled object counters (frustum, shadow, occlusion)
+    u32 cull_stats_id;
+    u32 depth_pyramid_id;
+    // Zero until a depth pyramid has been built
+    u32 occlusion_enabled;
+    // Height in pixels of the render image, for screen size culling
+    f32 render_height;
+    // Largest projected error in pixels of a picked level of detail
+    f32 lod_threshold;
+    f32 render_width;
+    // Camera clip distances, the light grid's depth slices span them
+    f32 z_near;
+    f32 z_far;
+    u32 light_count;
+    u32 cascade_count;
+    u32 shadow_cascade_mask;    // Cascades rerendered this frame, the others get no shadow draws
+    u32 shadow_filter;          // shadow_filter_type
+    f32 sun_angular_radius;     // Radians, sizes the penumbrae of PCSS
 } scene_data;
 
+// draw.firstInstance indexes the scene's instance buffer, which holds the transform index of
+// every instance drawn
 typedef struct draw_command {
     VkDrawIndexedIndirectCommand draw;
     u32 material_inst_id;
-    u32 transform_id;
+    u32 geo_id;             // Geometry of the vertices, needed to decode them
 } draw_command;
 
 typedef struct device {
@@ -141,4 +205,13 @@ typedef struct device {
     VkQueue compute_queue;
     VkQueue transfer_queue;
     VkQueue present_queue;
+
+    // minImageTransferGranularity of the transfer queue family, (0, 0, 0) allows only whole mip level copies
+    VkExtent3D transfer_image_granularity;
+
+    // timestampValidBits of the graphics queue family, 0 when it does not support timestamps
+    u32 timestamp_valid_bits;
+
+    // VK_EXT_memory_budget enabled
+    b8 memory_budget;
 } device;
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "gltfimporter.h"
 #include "importer_types.h"
+#include "lod.h"
+#include "mesh_optimize.h"
 
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
@@ -26,6 +28,7 @@
 
 static void recurse_print_nodes(cgltf_node* node, u32 depth, u64* node_count);
 static cgltf_accessor* get_accessor_from_attributes(cgltf_attribute* attributes, cgltf_size attributes_count, const char* name);
+static m4s* import_instance_transforms(cgltf_node* node, m4s world_transform);
 
 static void* load_image_data(cgltf_image* in_image, const char* gltf_path, int* width, int* height, int* channels);
 
@@ -169,6 +172,11 @@ b8 import_gltf(import_payload* payload, const char* path) {
     // TODO: Put vertex data into single vertex buffer & index data 
     // into single index buffer in this function.
     u32 mesh_start = dynarray_grow((void**)&payload->meshes, data->meshes_count);    
+    u64 vertices_before = 0;
+    u64 vertices_after = 0;
+    u64 triangle_count = 0;
+    u64 misses_before = 0;
+    u64 misses_after = 0;
     for (u32 i = 0; i < data->meshes_count; ++i) {
         import_mesh* mesh = &payload->meshes[mesh_start + i];
         mesh->count = data->meshes[i].primitives_count;
@@ -185,15 +193,15 @@ b8 import_gltf(import_payload* payload, const char* path) {
             cgltf_primitive prim = data->meshes[i].primitives[j];
             import_geometry* geo = &payload->geometries[geo_start + j];
 
-            // NOTE: Converts u16 indices to u32 indices
+            // NOTE: Widened to u32 for the import stages, the scene narrows geometries with fewer than 65536 vertices back to u16
             geo->indices = dynarray_create(prim.indices->count, sizeof(u32));
             dynarray_resize((void**)&geo->indices, prim.indices->count);
-            payload->index_count += prim.indices->count;
             cgltf_accessor_unpack_indices(prim.indices, geo->indices, sizeof(u32), prim.indices->count);
             
             // Make sure attribute 0 always has the max number of vertices
             u32 vertex_count = prim.attributes[0].data->count;
             geo->vertices = dynarray_create(vertex_count, sizeof(vertex));
+            geo->has_color = false;
             dynarray_resize((void**)&geo->vertices, vertex_count);
             payload->vertex_count += vertex_count;
             for (u32 i = 0; i < vertex_count; ++i) {
@@ -236,6 +244,7 @@ b8 import_gltf(import_payload* payload, const char* path) {
                         for (u32 l = 0; l < prim.attributes[k].data->count; l++) {
                             geo->vertices[l].color = colors[l];
                         }
+                        geo->has_color = true;
                         break;
                     // TODO: Implement
                     case cgltf_attribute_type_tangent: break;
@@ -251,6 +260,10 @@ b8 import_gltf(import_payload* payload, const char* path) {
             }
             dynarray_destroy(accessor_data);
 
+            vertices_before += vertex_count;
+            vertex_count = geometry_weld(geo, IMPORT_WELD_EPSILON);
+            vertices_after += vertex_count;
+
             // TODO: Frustum culling is causing pop-in
             v4s min_pos = glms_vec4(geo->vertices[0].position, 0.0f);
             v4s max_pos = glms_vec4(geo->vertices[0].position, 0.0f);
@@ -264,6 +277,17 @@ b8 import_gltf(import_payload* payload, const char* path) {
             geo->radius = glms_vec3_norm(glms_vec3(geo->extent));
             // TODO: END
 
+#if IMPORT_OPTIMIZE_GEOMETRY
+            u32 index_count = dynarray_length(geo->indices);
+            triangle_count += index_count / 3;
+            misses_before += vertex_cache_misses(geo->indices, index_count, vertex_count);
+            geometry_optimize(geo);
+            misses_after += vertex_cache_misses(geo->indices, index_count, dynarray_length(geo->vertices));
+#endif
+
+            lods_build(geo);
+            payload->index_count += dynarray_length(geo->indices);
+
             mesh->geometry_indices[j] = geo_start + j;
             // TODO: When pipelines are placed before this function, we can store the pipeline_id, instance_id combo here
             mesh->material_indices[j] = (prim.material) ? mat_index_id_offset + cgltf_material_index(data, prim.material) : mat_index_id_offset;
@@ -271,6 +295,13 @@ b8 import_gltf(import_payload* payload, const char* path) {
         }
     }
     // TODO: END
+    ETINFO("%s vertices: %llu before welding, %llu after.", path, vertices_before, vertices_after);
+#if IMPORT_OPTIMIZE_GEOMETRY
+    if (triangle_count) {
+        ETINFO("%s ACMR: %.3f before optimization, %.3f after.",
+            path, (f64)misses_before / triangle_count, (f64)misses_after / triangle_count);
+    }
+#endif
 
     // TODO: Create transform buffer from node transforms, just mesh nodes for now.
     u32 node_start = dynarray_grow((void**)&payload->nodes, data->nodes_count);
@@ -293,6 +324,20 @@ b8 import_gltf(import_payload* payload, const char* path) {
 
         cgltf_node_transform_local(&data->nodes[i], (cgltf_float*)node.local_transform.raw);
         cgltf_node_transform_world(&data->nodes[i], (cgltf_float*)node.world_transform.raw);
+        if (node.has_mesh && data->nodes[i].has_mesh_gpu_instancing) {
+            node.instance_transforms = import_instance_transforms(&data->nodes[i], node.world_transform);
+        }
+
+        // NOTE: Only point lights for now, spot & directional lights are skipped
+        cgltf_light* light = data->nodes[i].light;
+        if (light != NULL && light->type == cgltf_light_type_point) {
+            import_light point = {
+                .color = (v4s){.raw = {light->color[0], light->color[1], light->color[2], light->intensity}},
+                .position = node.world_transform.col[3],
+                .range = light->range,
+            };
+            dynarray_push((void**)&payload->lights, &point);
+        }
 
         payload->nodes[node_start + i] = node;
     }
@@ -488,4 +533,41 @@ static cgltf_accessor* get_accessor_from_attributes(cgltf_attribute* attributes,
         }
     }
     return (void*)0;
+}
+
+// EXT_mesh_gpu_instancing: every instance is drawn with the node's world transform times the
+// instance's TRS. Missing attributes are the identity. Returns a dynarray of world transforms
+static m4s* import_instance_transforms(cgltf_node* node, m4s world_transform) {
+    cgltf_attribute* attributes = node->mesh_gpu_instancing.attributes;
+    cgltf_size attributes_count = node->mesh_gpu_instancing.attributes_count;
+    cgltf_accessor* translations = get_accessor_from_attributes(attributes, attributes_count, "TRANSLATION");
+    cgltf_accessor* rotations = get_accessor_from_attributes(attributes, attributes_count, "ROTATION");
+    cgltf_accessor* scales = get_accessor_from_attributes(attributes, attributes_count, "SCALE");
+
+    // Attributes of one node all have the same count
+    cgltf_size instance_count = 0;
+    for (cgltf_size i = 0; i < attributes_count; ++i) {
+        instance_count = attributes[i].data->count;
+    }
+
+    m4s* transforms = dynarray_create(instance_count, sizeof(m4s));
+    for (cgltf_size i = 0; i < instance_count; ++i) {
+        v3s translation = glms_vec3_zero();
+        versors rotation = glms_quat_identity();
+        v3s scale = glms_vec3_one();
+        if (translations) {
+            cgltf_accessor_read_float(translations, i, translation.raw, 3);
+        }
+        if (rotations) {
+            cgltf_accessor_read_float(rotations, i, rotation.raw, 4);
+        }
+        if (scales) {
+            cgltf_accessor_read_float(scales, i, scale.raw, 3);
+        }
+        m4s instance = glms_mat4_mul(glms_translate_make(translation),
+            glms_mat4_mul(glms_quat_mat4(rotation), glms_scale_make(scale)));
+        m4s transform = glms_mat4_mul(world_transform, instance);
+        dynarray_push((void**)&transforms, &transform);
+    }
+    return transforms;
 }
\ No newline at end of file
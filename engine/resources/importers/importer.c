@@ -26,6 +26,7 @@ import_payload import_files(u32 file_count, const char* const* paths) {
         .geometries = dynarray_create(1, sizeof(import_geometry)),
         .meshes = dynarray_create(1, sizeof(import_mesh)),
         .nodes = dynarray_create(1, sizeof(import_node)),
+        .lights = dynarray_create(1, sizeof(import_light)),
     };
 
     // HACK: Place default dummy positions in the texture array for importing
@@ -68,6 +69,7 @@ void import_payload_destroy(import_payload* payload) {
     for (u32 i = 0; i < geometry_count; ++i) {
         dynarray_destroy(payload->geometries[i].vertices);
         dynarray_destroy(payload->geometries[i].indices);
+        dynarray_destroy(payload->geometries[i].meshlets);
     }
     dynarray_destroy(payload->geometries);
 
@@ -91,6 +93,10 @@ void import_payload_destroy(import_payload* payload) {
     u32 node_count = dynarray_length(payload->nodes);
     for (u32 i = 0; i < node_count; ++i) {
         dynarray_destroy(payload->nodes[i].children_indices);
+        if (payload->nodes[i].instance_transforms) {
+            dynarray_destroy(payload->nodes[i].instance_transforms);
+        }
     }
     dynarray_destroy(payload->nodes);
+    dynarray_destroy(payload->lights);
 }
\ No newline at end of file
@@ -32,7 +32,11 @@ typedef u32 sampler_property_flags;
 
 typedef struct import_geometry {
     vertex* vertices;
-    u32* indices;
+    b8 has_color;           // Vertex colors were imported, white otherwise
+    u32* indices;           // Dynarray, every level of detail back to back, full detail first
+    meshlet* meshlets;      // Dynarray, covers indices in order
+    u32 lod_count;
+    geometry_lod lods[GEOMETRY_MAX_LODS];   // Relative to indices & meshlets
     f32 radius;             // Bounding sphere radius
     v4s origin;             // Bounding box origin
     v4s extent;             // Bounding box extent
@@ -59,6 +63,8 @@ typedef enum reserved_texture_index {
     RESERVED_TEXTURE_BLACK_INDEX,
     RESERVED_TEXTURE_NORMAL_INDEX,
     RESERVED_TEXTURE_SHADOW_MAP_INDEX,
+    RESERVED_TEXTURE_DEPTH_PYRAMID_INDEX,
+    RESERVED_TEXTURE_SHADOW_COMPARE_INDEX,  // Shadow map with a comparison sampler
     RESERVED_TEXTURE_INDEX_COUNT,
 } reserved_texture_index;
 
@@ -92,6 +98,7 @@ typedef struct import_pipeline {
     u64 inst_size;
     import_pipeline_type type;
     b8 transparent;
+    b8 alpha_tested;    // Fragment shader discards below frame alpha_cutoff
 } import_pipeline;
 
 const static import_pipeline default_import_pipelines[IMPORT_PIPELINE_TYPE_MAX] = {
@@ -102,6 +109,7 @@ const static import_pipeline default_import_pipelines[IMPORT_PIPELINE_TYPE_MAX]
         .type = IMPORT_PIPELINE_TYPE_GLTF_DEFAULT,
         .instances = NULL,
         .transparent = false,
+        .alpha_tested = true,
     },
     [IMPORT_PIPELINE_TYPE_PMX_DEFAULT] = {
         .vert_path = "assets/shaders/cel.vert.spv.opt",
@@ -110,6 +118,7 @@ const static import_pipeline default_import_pipelines[IMPORT_PIPELINE_TYPE_MAX]
         .type = IMPORT_PIPELINE_TYPE_PMX_DEFAULT,
         .instances = NULL,
         .transparent = false,
+        .alpha_tested = false,
     },
     [IMPORT_PIPELINE_TYPE_GLTF_TRANSPARENT] = {
         .vert_path = "assets/shaders/pbr_mr.vert.spv.opt",
@@ -118,6 +127,7 @@ const static import_pipeline default_import_pipelines[IMPORT_PIPELINE_TYPE_MAX]
         .type = IMPORT_PIPELINE_TYPE_GLTF_TRANSPARENT,
         .instances = NULL,
         .transparent = true,
+        .alpha_tested = true,
     },
 };
 
@@ -137,8 +147,16 @@ typedef struct import_node {
     u32* children_indices;      // dynarray
     m4s local_transform;
     m4s world_transform;
+    m4s* instance_transforms;   // dynarray, EXT_mesh_gpu_instancing world transforms drawn instead of world_transform, 0 when not instanced
 } import_node;
 
+// KHR_lights_punctual point light in world space
+typedef struct import_light {
+    v4s color;              // rgb, a is the intensity
+    v4s position;
+    f32 range;              // 0 when the file leaves it unbounded
+} import_light;
+
 // NOTE: All dynarrays
 typedef struct import_payload {
     mat_id* mat_index_to_mat_id;        // Dynarray
@@ -154,6 +172,7 @@ typedef struct import_payload {
     import_mesh* meshes;                // Dynarray
 
     import_node* nodes;                 // Dynarray
+    import_light* lights;               // Dynarray
 } import_payload;
 
 // TODO: Serializing Beginning
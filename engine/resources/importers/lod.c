@@ -0,0 +1,175 @@
+#include "lod.h"
+#include "meshlet.h"
+
+#include "data_structures/dynarray.h"
+#include "memory/etmemory.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Each level has at most this fraction of the triangles of the level before it
+#define LOD_TRIANGLE_RATIO 0.5f
+// Coarser levels are not worth a range of their own
+#define LOD_MIN_TRIANGLES 16
+// Grid cells along the longest side of the bounding box for the first attempt
+#define LOD_START_GRID_RESOLUTION 256.0f
+// Grid coordinates are packed in 20 bits per axis
+#define LOD_MAX_CELL_COORD 0xFFFFF
+
+typedef struct cluster_vertex {
+    u64 key;                // Grid cell (x, y, z) & normal bucket
+    u32 index;
+} cluster_vertex;
+
+static u32* lod_simplify(vertex* vertices, u32* indices, u32 index_count, v3s min_pos, f32 cell_size, f32* error);
+static u32 normal_bucket(v3s normal);
+static int cluster_vertex_compare(const void* a, const void* b);
+
+void lods_build(import_geometry* geo) {
+    u32 full_count = dynarray_length(geo->indices);
+    geo->meshlets = meshlets_build(geo->vertices, geo->indices);
+    geo->lods[0] = (geometry_lod) {
+        .start_index = 0,
+        .index_count = full_count,
+        .meshlet_offset = 0,
+        .meshlet_count = dynarray_length(geo->meshlets),
+        .error = 0.0f,
+    };
+    geo->lod_count = 1;
+
+    v3s min_pos = glms_vec3(glms_vec4_sub(geo->origin, geo->extent));
+    f32 size = 2.0f * glm_max(geo->extent.x, glm_max(geo->extent.y, geo->extent.z));
+    if (size <= 0.0f) {
+        return;
+    }
+
+    f32 cell_size = size / LOD_START_GRID_RESOLUTION;
+    u32 target = (u32)(full_count / 3 * LOD_TRIANGLE_RATIO);
+    while (geo->lod_count < GEOMETRY_MAX_LODS && target >= LOD_MIN_TRIANGLES && cell_size <= size) {
+        f32 error;
+        // NOTE: geo->indices moves as levels are appended, the full detail mesh stays first
+        u32* lod_indices = lod_simplify(geo->vertices, geo->indices, full_count, min_pos, cell_size, &error);
+        u32 triangle_count = dynarray_length(lod_indices) / 3;
+        cell_size *= 2.0f;
+        if (triangle_count > target) {
+            dynarray_destroy(lod_indices);
+            continue;
+        }
+        if (triangle_count < LOD_MIN_TRIANGLES) {
+            dynarray_destroy(lod_indices);
+            break;
+        }
+
+        meshlet* lod_meshlets = meshlets_build(geo->vertices, lod_indices);
+        geometry_lod* lod = &geo->lods[geo->lod_count];
+        *lod = (geometry_lod) {
+            .start_index = dynarray_length(geo->indices),
+            .index_count = dynarray_length(lod_indices),
+            .meshlet_offset = dynarray_length(geo->meshlets),
+            .meshlet_count = dynarray_length(lod_meshlets),
+            // Errors increase with the level so the shader can stop at the first level over the threshold
+            .error = glm_max(error, geo->lods[geo->lod_count - 1].error),
+        };
+        geo->lod_count++;
+
+        dynarray_append_u32(&geo->indices, lod_indices);
+        u64 meshlet_start = dynarray_grow((void**)&geo->meshlets, lod->meshlet_count);
+        for (u32 i = 0; i < lod->meshlet_count; ++i) {
+            geo->meshlets[meshlet_start + i] = lod_meshlets[i];
+            geo->meshlets[meshlet_start + i].start_index += lod->start_index;
+        }
+        dynarray_destroy(lod_meshlets);
+        dynarray_destroy(lod_indices);
+
+        target = (u32)(triangle_count * LOD_TRIANGLE_RATIO);
+    }
+}
+
+// Returns a dynarray of the indices simplified with the given grid cell size
+static u32* lod_simplify(vertex* vertices, u32* indices, u32 index_count, v3s min_pos, f32 cell_size, f32* error) {
+    u32 vertex_count = dynarray_length(vertices);
+    cluster_vertex* cells = etallocate(sizeof(cluster_vertex) * vertex_count, MEMORY_TAG_IMPORTER);
+    for (u32 i = 0; i < vertex_count; ++i) {
+        v3s cell = glms_vec3_divs(glms_vec3_sub(vertices[i].position, min_pos), cell_size);
+        u64 x = (u64)glm_clamp(cell.x, 0.0f, (f32)LOD_MAX_CELL_COORD);
+        u64 y = (u64)glm_clamp(cell.y, 0.0f, (f32)LOD_MAX_CELL_COORD);
+        u64 z = (u64)glm_clamp(cell.z, 0.0f, (f32)LOD_MAX_CELL_COORD);
+        cells[i] = (cluster_vertex) {
+            .key = (x << 43) | (y << 23) | (z << 3) | normal_bucket(vertices[i].normal),
+            .index = i,
+        };
+    }
+    qsort(cells, vertex_count, sizeof(cluster_vertex), cluster_vertex_compare);
+
+    // Collapse every run of equal keys into the vertex closest to the run's average position
+    u32* remap = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    *error = 0.0f;
+    u32 run_start = 0;
+    while (run_start < vertex_count) {
+        u32 run_end = run_start + 1;
+        while (run_end < vertex_count && cells[run_end].key == cells[run_start].key) {
+            run_end++;
+        }
+
+        v3s average = glms_vec3_zero();
+        for (u32 i = run_start; i < run_end; ++i) {
+            average = glms_vec3_add(average, vertices[cells[i].index].position);
+        }
+        average = glms_vec3_divs(average, (f32)(run_end - run_start));
+
+        u32 representative = cells[run_start].index;
+        f32 closest = glms_vec3_distance2(average, vertices[representative].position);
+        for (u32 i = run_start + 1; i < run_end; ++i) {
+            f32 distance = glms_vec3_distance2(average, vertices[cells[i].index].position);
+            if (distance < closest) {
+                closest = distance;
+                representative = cells[i].index;
+            }
+        }
+
+        v3s position = vertices[representative].position;
+        for (u32 i = run_start; i < run_end; ++i) {
+            remap[cells[i].index] = representative;
+            *error = glm_max(*error, glms_vec3_distance(position, vertices[cells[i].index].position));
+        }
+        run_start = run_end;
+    }
+
+    u32* lod_indices = dynarray_create(index_count, sizeof(u32));
+    for (u32 i = 0; i + 2 < index_count; i += 3) {
+        u32 a = remap[indices[i + 0]];
+        u32 b = remap[indices[i + 1]];
+        u32 c = remap[indices[i + 2]];
+        if (a == b || b == c || c == a) {
+            continue;
+        }
+        u64 start = dynarray_grow((void**)&lod_indices, 3);
+        lod_indices[start + 0] = a;
+        lod_indices[start + 1] = b;
+        lod_indices[start + 2] = c;
+    }
+
+    etfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    etfree(cells, sizeof(cluster_vertex) * vertex_count, MEMORY_TAG_IMPORTER);
+    return lod_indices;
+}
+
+// Dominant axis & sign of the normal, 0 to 5
+static u32 normal_bucket(v3s normal) {
+    f32 x = fabsf(normal.x);
+    f32 y = fabsf(normal.y);
+    f32 z = fabsf(normal.z);
+    if (x >= y && x >= z) {
+        return (normal.x < 0.0f) ? 1 : 0;
+    }
+    if (y >= z) {
+        return (normal.y < 0.0f) ? 3 : 2;
+    }
+    return (normal.z < 0.0f) ? 5 : 4;
+}
+
+static int cluster_vertex_compare(const void* a, const void* b) {
+    u64 key_a = ((const cluster_vertex*)a)->key;
+    u64 key_b = ((const cluster_vertex*)b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
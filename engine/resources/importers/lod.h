@@ -0,0 +1,23 @@
+#pragma once
+#include "defines.h"
+#include "math/math_types.h"
+#include "importer_types.h"
+
+/** NOTE: Level of detail generation
+ * Levels are simplified from the full detail mesh by vertex clustering: vertices are
+ * bucketed into a uniform grid over the bounding box, split further by the dominant axis of
+ * their normal so hard edges survive, & every bucket collapses into the vertex closest to
+ * the bucket's average position. Triangles that lose an edge are dropped. No vertices are
+ * added, the levels only index the existing ones.
+ *
+ * The grid cell size doubles until a level has at most half the triangles of the level
+ * before it. A level's error is the furthest any vertex moved, which bounds how far the
+ * simplified surface is from the full detail surface.
+ *
+ * Texture coordinates are not considered when collapsing, seams smear on the coarse levels.
+ * The error is geometric, so such levels are only picked when they are small on screen.
+ */
+
+// Appends the levels of detail of geo to geo->indices, builds the meshlets of every level &
+// fills geo->lods. Expects geo->indices to hold the full detail mesh & the bounds to be set
+void lods_build(import_geometry* geo);
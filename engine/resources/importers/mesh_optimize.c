@@ -0,0 +1,376 @@
+#include "mesh_optimize.h"
+
+#include "data_structures/dynarray.h"
+#include "memory/etmemory.h"
+
+#include <math.h>
+#include <stdlib.h>
+// NOTE: string.h included for memcmp
+#include <string.h>
+
+// Scoring parameters from Forsyth's paper, tuned for a 32 entry LRU cache
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+typedef struct overdraw_cluster {
+    f32 key;                // Distance of the cluster from the center along its normal
+    u32 start;              // First triangle
+    u32 count;
+} overdraw_cluster;
+
+static vertex weld_key(const vertex* v, f32 epsilon);
+static u32 weld_hash(const vertex* key);
+static void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count);
+static void optimize_overdraw(vertex* vertices, u32* indices, u32 index_count, v3s center);
+static void optimize_vertex_fetch(import_geometry* geo);
+static f32 forsyth_vertex_score(i32 cache_position, u32 remaining_valence);
+static int overdraw_cluster_compare(const void* a, const void* b);
+
+u32 geometry_weld(import_geometry* geo, f32 epsilon) {
+    u32 vertex_count = dynarray_length(geo->vertices);
+    u32 index_count = dynarray_length(geo->indices);
+
+    // Power of two & at most half full so probe sequences stay short
+    u32 table_size = 1;
+    while (table_size < vertex_count * 2) {
+        table_size <<= 1;
+    }
+    u32 mask = table_size - 1;
+    u32* table = etallocate(sizeof(u32) * table_size, MEMORY_TAG_IMPORTER);
+    for (u32 i = 0; i < table_size; ++i) {
+        table[i] = INVALID_ID;
+    }
+
+    u32* remap = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    vertex* welded = dynarray_create(vertex_count, sizeof(vertex));
+    for (u32 i = 0; i < vertex_count; ++i) {
+        vertex key = weld_key(&geo->vertices[i], epsilon);
+        u32 slot = weld_hash(&key) & mask;
+        while (table[slot] != INVALID_ID) {
+            vertex other = weld_key(&welded[table[slot]], epsilon);
+            if (memcmp(&key, &other, sizeof(vertex)) == 0) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] == INVALID_ID) {
+            table[slot] = dynarray_length(welded);
+            dynarray_push((void**)&welded, &geo->vertices[i]);
+        }
+        remap[i] = table[slot];
+    }
+
+    for (u32 i = 0; i < index_count; ++i) {
+        geo->indices[i] = remap[geo->indices[i]];
+    }
+    dynarray_destroy(geo->vertices);
+    geo->vertices = welded;
+
+    etfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    etfree(table, sizeof(u32) * table_size, MEMORY_TAG_IMPORTER);
+    return dynarray_length(welded);
+}
+
+void geometry_optimize(import_geometry* geo) {
+    u32 index_count = dynarray_length(geo->indices);
+    u32 vertex_count = dynarray_length(geo->vertices);
+    optimize_vertex_cache(geo->indices, index_count, vertex_count);
+    optimize_overdraw(geo->vertices, geo->indices, index_count, glms_vec3(geo->origin));
+    optimize_vertex_fetch(geo);
+}
+
+u32 vertex_cache_misses(u32* indices, u32 index_count, u32 vertex_count) {
+    // Miss count when each vertex last entered the cache, zero for never. A FIFO cache still
+    // holds a vertex until VERTEX_CACHE_MEASURE_SIZE misses have happened after it
+    u32* entered = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    etzero_memory(entered, sizeof(u32) * vertex_count);
+    u32 misses = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        if (entered[v] == 0 || misses - entered[v] >= VERTEX_CACHE_MEASURE_SIZE) {
+            entered[v] = ++misses;
+        }
+    }
+    etfree(entered, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    return misses;
+}
+
+static void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count) {
+    u32 triangle_count = index_count / 3;
+    if (!triangle_count) {
+        return;
+    }
+
+    // Triangles of each vertex, the first valence[v] entries of a vertex's range are not emitted yet
+    u32* valence = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    u32* offsets = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    u32* adjacency = etallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_IMPORTER);
+    etzero_memory(valence, sizeof(u32) * vertex_count);
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        valence[indices[i]]++;
+    }
+    u32 offset = 0;
+    for (u32 i = 0; i < vertex_count; ++i) {
+        offsets[i] = offset;
+        offset += valence[i];
+    }
+    etzero_memory(valence, sizeof(u32) * vertex_count);
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        u32 v = indices[i];
+        adjacency[offsets[v] + valence[v]++] = i / 3;
+    }
+
+    f32* vertex_scores = etallocate(sizeof(f32) * vertex_count, MEMORY_TAG_IMPORTER);
+    for (u32 i = 0; i < vertex_count; ++i) {
+        vertex_scores[i] = forsyth_vertex_score(-1, valence[i]);
+    }
+    b8* emitted = etallocate(sizeof(b8) * triangle_count, MEMORY_TAG_IMPORTER);
+    etzero_memory(emitted, sizeof(b8) * triangle_count);
+    u32* output = etallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_IMPORTER);
+
+    i32 best = -1;
+    f32 best_score = -1.0f;
+    for (u32 i = 0; i < triangle_count; ++i) {
+        f32 score = vertex_scores[indices[i * 3 + 0]] + vertex_scores[indices[i * 3 + 1]] + vertex_scores[indices[i * 3 + 2]];
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+
+    u32 cache[FORSYTH_CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u32 input_cursor = 0;
+    for (u32 emit = 0; emit < triangle_count; ++emit) {
+        if (best < 0) {
+            // No cached vertex has triangles left, continue with the next triangle in input order
+            while (emitted[input_cursor]) {
+                input_cursor++;
+            }
+            best = input_cursor;
+        }
+        u32* tri = indices + best * 3;
+        emitted[best] = true;
+        etcopy_memory(output + emit * 3, tri, sizeof(u32) * 3);
+
+        for (u32 j = 0; j < 3; ++j) {
+            u32 v = tri[j];
+            u32* triangles = adjacency + offsets[v];
+            for (u32 k = 0; k < valence[v]; ++k) {
+                if (triangles[k] == (u32)best) {
+                    triangles[k] = triangles[valence[v] - 1];
+                    valence[v]--;
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices move to the front, the rest keep their order
+        u32 new_cache[FORSYTH_CACHE_SIZE + 3];
+        u32 new_count = 0;
+        for (u32 j = 0; j < 3; ++j) {
+            b8 cached = false;
+            for (u32 k = 0; k < new_count && !cached; ++k) {
+                cached = new_cache[k] == tri[j];
+            }
+            if (!cached) {
+                new_cache[new_count++] = tri[j];
+            }
+        }
+        for (u32 k = 0; k < cache_count; ++k) {
+            u32 v = cache[k];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache[new_count++] = v;
+            }
+        }
+        for (u32 k = FORSYTH_CACHE_SIZE; k < new_count; ++k) {
+            u32 v = new_cache[k];
+            vertex_scores[v] = forsyth_vertex_score(-1, valence[v]);
+        }
+        cache_count = (new_count < FORSYTH_CACHE_SIZE) ? new_count : FORSYTH_CACHE_SIZE;
+        for (u32 k = 0; k < cache_count; ++k) {
+            u32 v = new_cache[k];
+            cache[k] = v;
+            vertex_scores[v] = forsyth_vertex_score(k, valence[v]);
+        }
+
+        // Only triangles of cached vertices changed score, pick the best of them
+        best = -1;
+        best_score = -1.0f;
+        for (u32 k = 0; k < cache_count; ++k) {
+            u32 v = cache[k];
+            u32* triangles = adjacency + offsets[v];
+            for (u32 t = 0; t < valence[v]; ++t) {
+                u32* other = indices + triangles[t] * 3;
+                f32 score = vertex_scores[other[0]] + vertex_scores[other[1]] + vertex_scores[other[2]];
+                if (score > best_score) {
+                    best_score = score;
+                    best = triangles[t];
+                }
+            }
+        }
+    }
+    etcopy_memory(indices, output, sizeof(u32) * triangle_count * 3);
+
+    etfree(output, sizeof(u32) * triangle_count * 3, MEMORY_TAG_IMPORTER);
+    etfree(emitted, sizeof(b8) * triangle_count, MEMORY_TAG_IMPORTER);
+    etfree(vertex_scores, sizeof(f32) * vertex_count, MEMORY_TAG_IMPORTER);
+    etfree(adjacency, sizeof(u32) * triangle_count * 3, MEMORY_TAG_IMPORTER);
+    etfree(offsets, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    etfree(valence, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+}
+
+static void optimize_overdraw(vertex* vertices, u32* indices, u32 index_count, v3s center) {
+    u32 triangle_count = index_count / 3;
+    u32 vertex_count = dynarray_length(vertices);
+    if (!triangle_count) {
+        return;
+    }
+
+    // Split where a triangle misses the cache with every vertex, see vertex_cache_misses
+    u32* entered = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    etzero_memory(entered, sizeof(u32) * vertex_count);
+    u32 misses = 0;
+    overdraw_cluster* clusters = dynarray_create(1, sizeof(overdraw_cluster));
+    overdraw_cluster current = {.key = 0.0f, .start = 0, .count = 0};
+    for (u32 i = 0; i < triangle_count; ++i) {
+        u32 triangle_misses = 0;
+        for (u32 j = 0; j < 3; ++j) {
+            u32 v = indices[i * 3 + j];
+            if (entered[v] == 0 || misses - entered[v] >= VERTEX_CACHE_MEASURE_SIZE) {
+                entered[v] = ++misses;
+                triangle_misses++;
+            }
+        }
+        if (triangle_misses == 3 && current.count) {
+            dynarray_push((void**)&clusters, &current);
+            current = (overdraw_cluster){.key = 0.0f, .start = i, .count = 0};
+        }
+        current.count++;
+    }
+    dynarray_push((void**)&clusters, &current);
+    etfree(entered, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+
+    // Area weighted centroid & normal of each cluster
+    u32 cluster_count = dynarray_length(clusters);
+    for (u32 i = 0; i < cluster_count; ++i) {
+        v3s centroid = glms_vec3_zero();
+        v3s normal = glms_vec3_zero();
+        f32 area = 0.0f;
+        for (u32 t = clusters[i].start; t < clusters[i].start + clusters[i].count; ++t) {
+            v3s a = vertices[indices[t * 3 + 0]].position;
+            v3s b = vertices[indices[t * 3 + 1]].position;
+            v3s c = vertices[indices[t * 3 + 2]].position;
+            v3s n = glms_vec3_cross(glms_vec3_sub(b, a), glms_vec3_sub(c, a));
+            f32 tri_area = glms_vec3_norm(n);
+            centroid = glms_vec3_add(centroid, glms_vec3_scale(glms_vec3_add(glms_vec3_add(a, b), c), tri_area / 3.0f));
+            normal = glms_vec3_add(normal, n);
+            area += tri_area;
+        }
+        if (area > 0.0f) {
+            centroid = glms_vec3_divs(centroid, area);
+        }
+        clusters[i].key = glms_vec3_dot(glms_vec3_sub(centroid, center), glms_vec3_normalize(normal));
+    }
+    qsort(clusters, cluster_count, sizeof(overdraw_cluster), overdraw_cluster_compare);
+
+    u32* output = etallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_IMPORTER);
+    u32 output_offset = 0;
+    for (u32 i = 0; i < cluster_count; ++i) {
+        etcopy_memory(output + output_offset, indices + clusters[i].start * 3, sizeof(u32) * clusters[i].count * 3);
+        output_offset += clusters[i].count * 3;
+    }
+    etcopy_memory(indices, output, sizeof(u32) * triangle_count * 3);
+
+    etfree(output, sizeof(u32) * triangle_count * 3, MEMORY_TAG_IMPORTER);
+    dynarray_destroy(clusters);
+}
+
+static void optimize_vertex_fetch(import_geometry* geo) {
+    u32 vertex_count = dynarray_length(geo->vertices);
+    u32 index_count = dynarray_length(geo->indices);
+    u32* remap = etallocate(sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+    for (u32 i = 0; i < vertex_count; ++i) {
+        remap[i] = INVALID_ID;
+    }
+
+    vertex* vertices = dynarray_create(vertex_count, sizeof(vertex));
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = geo->indices[i];
+        if (remap[v] == INVALID_ID) {
+            remap[v] = dynarray_length(vertices);
+            dynarray_push((void**)&vertices, &geo->vertices[v]);
+        }
+        geo->indices[i] = remap[v];
+    }
+    dynarray_destroy(geo->vertices);
+    geo->vertices = vertices;
+
+    etfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_IMPORTER);
+}
+
+// Vertex compared by welding, every attribute snapped to the epsilon grid
+static vertex weld_key(const vertex* v, f32 epsilon) {
+    vertex key;
+    // Zero the whole struct so padding never takes part in the comparison
+    etzero_memory(&key, sizeof(vertex));
+    key.position = v->position;
+    key.normal = v->normal;
+    key.uv_x = v->uv_x;
+    key.uv_y = v->uv_y;
+    key.color = v->color;
+    if (epsilon > 0.0f) {
+        f32* attributes[] = {
+            &key.position.x, &key.position.y, &key.position.z,
+            &key.normal.x, &key.normal.y, &key.normal.z,
+            &key.uv_x, &key.uv_y,
+            &key.color.x, &key.color.y, &key.color.z, &key.color.w,
+        };
+        for (u32 i = 0; i < sizeof(attributes) / sizeof(attributes[0]); ++i) {
+            // Adding zero turns -0 into +0 so both compare equal bitwise
+            *attributes[i] = roundf(*attributes[i] / epsilon) + 0.0f;
+        }
+    }
+    return key;
+}
+
+// FNV-1a over the bytes of the key
+static u32 weld_hash(const vertex* key) {
+    const u8* bytes = (const u8*)key;
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < sizeof(vertex); ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static f32 forsyth_vertex_score(i32 cache_position, u32 remaining_valence) {
+    // Vertices without triangles left should not pull any triangle in
+    if (!remaining_valence) {
+        return -1.0f;
+    }
+    f32 score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // Used by the last triangle, fixed score so the next triangle is not always adjacent to it
+            score = FORSYTH_LAST_TRI_SCORE;
+        } else {
+            f32 scaler = 1.0f - (f32)(cache_position - 3) / (FORSYTH_CACHE_SIZE - 3);
+            score = powf(scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+    // Boost vertices with few triangles left so they are finished off & leave the cache
+    score += FORSYTH_VALENCE_BOOST_SCALE * powf((f32)remaining_valence, -FORSYTH_VALENCE_BOOST_POWER);
+    return score;
+}
+
+// Sorts clusters facing away from the center first
+static int overdraw_cluster_compare(const void* a, const void* b) {
+    f32 key_a = ((const overdraw_cluster*)a)->key;
+    f32 key_b = ((const overdraw_cluster*)b)->key;
+    return (key_a < key_b) - (key_a > key_b);
+}
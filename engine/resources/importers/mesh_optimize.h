@@ -0,0 +1,43 @@
+#pragma once
+#include "defines.h"
+#include "math/math_types.h"
+#include "importer_types.h"
+
+/** NOTE: Welding
+ * Vertices are hashed into an open addressing table & every vertex equal to one already in
+ * the table is replaced by it, the indices are rewritten to match. With an epsilon of 0
+ * only bit identical vertices merge. Otherwise every attribute is snapped to a grid of
+ * epsilon before comparing, vertices on either side of a grid line do not merge.
+ */
+
+/** NOTE: Geometry optimization
+ * Reorders the triangles & vertices of a geometry without changing what is drawn:
+ * 1. Vertex cache: Tom Forsyth's linear speed vertex cache optimization, triangles are
+ *    greedily emitted by a score favouring vertices recently used & vertices with few
+ *    triangles left, so the post transform cache is reused.
+ * 2. Overdraw: the cache ordered triangles are split into clusters wherever a triangle
+ *    misses the cache with all of its vertices. Clusters facing away from the bounding box
+ *    center are drawn first, as they tend to occlude the rest of the geometry. Triangles keep
+ *    their order inside a cluster so most of the cache reuse survives.
+ * 3. Vertex fetch: vertices are reordered by first use in the index buffer & unreferenced
+ *    vertices are dropped.
+ */
+
+// Set to 0 to import geometry in the order of the file
+#define IMPORT_OPTIMIZE_GEOMETRY 1
+
+// Attribute tolerance of welding, 0 merges bit identical vertices only
+#define IMPORT_WELD_EPSILON 0.0f
+
+// Merges duplicate vertices of geo & rewrites its indices. Returns the new vertex count
+u32 geometry_weld(import_geometry* geo, f32 epsilon);
+
+// Post transform cache size used to measure ACMR (average cache miss ratio)
+#define VERTEX_CACHE_MEASURE_SIZE 16
+
+// Optimizes geo's triangle & vertex order. Expects the bounds to be set
+void geometry_optimize(import_geometry* geo);
+
+// Vertex shader invocations with a FIFO post transform cache of VERTEX_CACHE_MEASURE_SIZE
+// entries. Divided by the triangle count this is the ACMR.
+u32 vertex_cache_misses(u32* indices, u32 index_count, u32 vertex_count);
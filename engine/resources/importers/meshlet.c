@@ -0,0 +1,121 @@
+#include "meshlet.h"
+
+#include "data_structures/dynarray.h"
+
+#include <math.h>
+
+// Meshlets with a face normal this close to perpendicular to the cone axis are not cone culled
+#define MESHLET_CONE_MIN_DOT 0.1f
+
+static void meshlet_compute_bounds(vertex* vertices, u32* indices, meshlet* m);
+
+meshlet* meshlets_build(vertex* vertices, u32* indices) {
+    u32 index_count = dynarray_length(indices);
+    meshlet* meshlets = dynarray_create(index_count / (3 * MESHLET_MAX_TRIANGLES) + 1, sizeof(meshlet));
+
+    u32 meshlet_vertices[MESHLET_MAX_VERTICES];
+    u32 vertex_count = 0;
+    meshlet current = {.start_index = 0, .index_count = 0};
+    for (u32 i = 0; i + 2 < index_count; i += 3) {
+        // Count the triangle's vertices that are not in the meshlet yet
+        u32 new_vertices[3];
+        u32 new_count = 0;
+        for (u32 j = 0; j < 3; ++j) {
+            u32 index = indices[i + j];
+            b8 found = false;
+            for (u32 k = 0; k < vertex_count && !found; ++k) {
+                found = meshlet_vertices[k] == index;
+            }
+            for (u32 k = 0; k < new_count && !found; ++k) {
+                found = new_vertices[k] == index;
+            }
+            if (!found) {
+                new_vertices[new_count++] = index;
+            }
+        }
+
+        if (vertex_count + new_count > MESHLET_MAX_VERTICES ||
+            current.index_count / 3 + 1 > MESHLET_MAX_TRIANGLES) {
+            meshlet_compute_bounds(vertices, indices, &current);
+            dynarray_push((void**)&meshlets, &current);
+            current = (meshlet){.start_index = i, .index_count = 0};
+            vertex_count = 0;
+            // Every vertex of the triangle is new to an empty meshlet
+            new_count = 0;
+            for (u32 j = 0; j < 3; ++j) {
+                u32 index = indices[i + j];
+                b8 found = false;
+                for (u32 k = 0; k < new_count && !found; ++k) {
+                    found = new_vertices[k] == index;
+                }
+                if (!found) {
+                    new_vertices[new_count++] = index;
+                }
+            }
+        }
+
+        for (u32 j = 0; j < new_count; ++j) {
+            meshlet_vertices[vertex_count++] = new_vertices[j];
+        }
+        current.index_count += 3;
+    }
+    if (current.index_count) {
+        meshlet_compute_bounds(vertices, indices, &current);
+        dynarray_push((void**)&meshlets, &current);
+    }
+    return meshlets;
+}
+
+static void meshlet_compute_bounds(vertex* vertices, u32* indices, meshlet* m) {
+    u32* tri_indices = indices + m->start_index;
+
+    // Bounding sphere centered on the bounding box
+    v3s min_pos = vertices[tri_indices[0]].position;
+    v3s max_pos = min_pos;
+    for (u32 i = 0; i < m->index_count; ++i) {
+        min_pos = glms_vec3_minv(min_pos, vertices[tri_indices[i]].position);
+        max_pos = glms_vec3_maxv(max_pos, vertices[tri_indices[i]].position);
+    }
+    v3s center = glms_vec3_scale(glms_vec3_add(min_pos, max_pos), 0.5f);
+    f32 radius = 0.0f;
+    for (u32 i = 0; i < m->index_count; ++i) {
+        radius = glm_max(radius, glms_vec3_distance(center, vertices[tri_indices[i]].position));
+    }
+    m->sphere = glms_vec4(center, radius);
+
+    // Normal cone
+    v3s normals[MESHLET_MAX_TRIANGLES];
+    u32 normal_count = 0;
+    v3s axis = glms_vec3_zero();
+    for (u32 i = 0; i < m->index_count; i += 3) {
+        v3s a = vertices[tri_indices[i + 0]].position;
+        v3s b = vertices[tri_indices[i + 1]].position;
+        v3s c = vertices[tri_indices[i + 2]].position;
+        v3s n = glms_vec3_cross(glms_vec3_sub(b, a), glms_vec3_sub(c, a));
+        f32 length = glms_vec3_norm(n);
+        // Degenerate triangles do not face anywhere
+        if (length <= 1e-12f) {
+            continue;
+        }
+        normals[normal_count] = glms_vec3_divs(n, length);
+        axis = glms_vec3_add(axis, normals[normal_count]);
+        normal_count++;
+    }
+
+    m->cone = glms_vec4(glms_vec3_zero(), 1.0f);
+    f32 axis_length = glms_vec3_norm(axis);
+    if (!normal_count || axis_length <= 1e-6f) {
+        return;
+    }
+    axis = glms_vec3_divs(axis, axis_length);
+
+    f32 min_dot = 1.0f;
+    for (u32 i = 0; i < normal_count; ++i) {
+        min_dot = glm_min(min_dot, glms_vec3_dot(normals[i], axis));
+    }
+    if (min_dot <= MESHLET_CONE_MIN_DOT) {
+        return;
+    }
+    // Sine of the cone's half angle, see cone_backfacing in culling.glsl
+    m->cone = glms_vec4(axis, sqrtf(1.0f - min_dot * min_dot));
+}
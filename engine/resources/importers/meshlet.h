@@ -0,0 +1,17 @@
+#pragma once
+#include "defines.h"
+#include "math/math_types.h"
+#include "resources/resource_types.h"
+
+/** NOTE: Meshlets
+ * Triangles are taken in index buffer order & appended to the current meshlet until it
+ * would exceed MESHLET_MAX_VERTICES unique vertices or MESHLET_MAX_TRIANGLES triangles.
+ * Each meshlet is a contiguous range of the index buffer so the indices are not reordered
+ * & a meshlet draws as a regular indexed draw.
+ *
+ * The normal cone is built from the face normals with counter clockwise front faces.
+ * Meshlets whose normals spread too far get a cutoff of 1 so they are never backface culled.
+ */
+
+// Returns a dynarray of meshlets covering every triangle of indices
+meshlet* meshlets_build(vertex* vertices, u32* indices);
@@ -10,6 +10,8 @@
 #include "renderer/src/buffer.h"
 #include "scene/scene_private.h"
 
+static b8 mat_pipe_prepass_init(mat_pipe* material, scene* scene, renderer_state* state, const mat_pipe_config* config);
+
 b8 mat_pipe_init(mat_pipe* material, scene* scene, renderer_state* state, const mat_pipe_config* config) {
     // TODO: Create function to load shaders specifically for material shaders & such 
     shader mat_vert;
@@ -53,19 +55,37 @@ b8 mat_pipe_init(mat_pipe* material, scene* scene, renderer_state* state, const
     pipeline_builder_set_color_attachment_format(&builder, scene->render_image.format);
     pipeline_builder_set_depth_attachment_format(&builder, scene->depth_image.format);
     material->pipe = pipeline_builder_build(&builder, state);
-    pipeline_builder_destroy(&builder);
-
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, material->pipe, "MatPipe");
 
+    material->prepass_pipe = VK_NULL_HANDLE;
+    material->equal_pipe = VK_NULL_HANDLE;
+    if (!config->transparent) {
+        // Geometry pass after the depth prepass, only the visible surface is shaded
+        pipeline_builder_enable_depthtest(&builder, false, VK_COMPARE_OP_EQUAL);
+        material->equal_pipe = pipeline_builder_build(&builder, state);
+        SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, material->equal_pipe, "MatEqualPipe");
+    }
+    pipeline_builder_destroy(&builder);
+
     unload_shader(state, &mat_vert);
     unload_shader(state, &mat_frag);
+
+    if (!config->transparent && !mat_pipe_prepass_init(material, scene, state, config)) {
+        ETERROR("Unable to create the depth prepass pipeline of material pipeline %s.", config->frag_path);
+        vkDestroyPipeline(state->device.handle, material->pipe, state->allocator);
+        vkDestroyPipeline(state->device.handle, material->equal_pipe, state->allocator);
+        material->pipe = VK_NULL_HANDLE;
+        material->equal_pipe = VK_NULL_HANDLE;
+        return false;
+    }
     // TEMP: END
 
     buffer_create(
         state,
-        sizeof(draw_command) * MAX_DRAW_COMMANDS,
+        sizeof(draw_command) * MAX_DRAW_COMMANDS * DRAW_INDEX_TYPE_COUNT,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
         &material->draws_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, material->draws_buffer.handle, "MatDrawsBuffer");
     buffer_create(
@@ -73,15 +93,11 @@ b8 mat_pipe_init(mat_pipe* material, scene* scene, renderer_state* state, const
         config->inst_size * MAX_MATERIAL_COUNT,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        GPU_MEMORY_TAG_MATERIAL,
         &material->inst_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, material->inst_buffer.handle, "MatInstanceDataBuffer");
-    VK_CHECK(vkMapMemory(
-        state->device.handle,
-        material->inst_buffer.memory,
-        /* Offset */ 0,
-        VK_WHOLE_SIZE,
-        /* Flags */ 0,
-        &material->inst_data));
+    // NOTE: Host visible memory is persistently mapped by the gpu allocator
+    material->inst_data = material->inst_buffer.alloc.mapped;
     etcopy_memory(material->inst_data, config->instances, config->inst_count * config->inst_size);
     material->inst_count = config->inst_count;
     material->inst_size = config->inst_size;
@@ -139,10 +155,53 @@ b8 mat_pipe_init(mat_pipe* material, scene* scene, renderer_state* state, const
 // TODO: Handle destroying the descriptor set handle for the pipeline, currently handled when 
 // the scene's descriptor pool is destroyed.
 void mat_pipe_shutdown(mat_pipe* material, scene* scene, renderer_state* state) {
-    vkUnmapMemory(state->device.handle, material->inst_buffer.memory);
     buffer_destroy(state, &material->inst_buffer);
     buffer_destroy(state, &material->draws_buffer);
     vkDestroyPipeline(state->device.handle, material->pipe, state->allocator);
+    vkDestroyPipeline(state->device.handle, material->prepass_pipe, state->allocator);
+    vkDestroyPipeline(state->device.handle, material->equal_pipe, state->allocator);
+}
+
+// Depth only pipeline of the depth prepass. Reads the position stream alone unless the material
+// is alpha tested, then the color texture alpha is tested like the material fragment shader does
+static b8 mat_pipe_prepass_init(mat_pipe* material, scene* scene, renderer_state* state, const mat_pipe_config* config) {
+    pipeline_builder builder = pipeline_builder_create();
+    builder.layout = scene->mat_pipeline_layout;
+
+    shader depth_vert;
+    shader depth_frag = {0};
+    if (config->alpha_tested) {
+        if (!load_shader(state, "assets/shaders/depth_mask.vert.spv.opt", &depth_vert)) {
+            return false;
+        }
+        if (!load_shader(state, "assets/shaders/depth_mask.frag.spv.opt", &depth_frag)) {
+            unload_shader(state, &depth_vert);
+            return false;
+        }
+        pipeline_builder_set_vertex_fragment(&builder, depth_vert, depth_frag);
+    } else {
+        if (!load_shader(state, "assets/shaders/depth.vert.spv.opt", &depth_vert)) {
+            return false;
+        }
+        pipeline_builder_set_vertex_only(&builder, depth_vert);
+    }
+    pipeline_builder_set_input_topology(&builder, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline_builder_set_polygon_mode(&builder, VK_POLYGON_MODE_FILL);
+    // NOTE: Must match the material pipeline so the same fragments reach the EQUAL test
+    pipeline_builder_set_cull_mode(&builder, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+    pipeline_builder_set_multisampling_none(&builder);
+    pipeline_builder_disable_blending(&builder);
+    pipeline_builder_enable_depthtest(&builder, true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    pipeline_builder_set_depth_attachment_format(&builder, scene->depth_image.format);
+    material->prepass_pipe = pipeline_builder_build(&builder, state);
+    pipeline_builder_destroy(&builder);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, material->prepass_pipe, "MatPrepassPipe");
+
+    unload_shader(state, &depth_vert);
+    if (config->alpha_tested) {
+        unload_shader(state, &depth_frag);
+    }
+    return material->prepass_pipe != VK_NULL_HANDLE;
 }
 
 // Linear allocation at the moment
@@ -13,6 +13,9 @@ typedef enum mat_set_bindings {
 typedef struct mat_pipe {
     // Info for renderer
     VkPipeline pipe;
+    // Opaque pipelines only, VK_NULL_HANDLE for transparent ones
+    VkPipeline prepass_pipe;    // Depth only, alpha tested when the material is
+    VkPipeline equal_pipe;      // pipe testing EQUAL against the prepass depth without writing it
     VkDescriptorSet set;
     buffer draws_buffer;
 
@@ -32,6 +35,7 @@ typedef struct mat_pipe_config {
     u32 inst_count;
     void* instances;
     b8 transparent;
+    b8 alpha_tested;
 } mat_pipe_config;
 
 b8 mat_pipe_init(mat_pipe* material, scene* scene, renderer_state* state, const mat_pipe_config* config);
@@ -19,18 +19,63 @@ typedef struct mat_id {
     u32 inst_id;
 } mat_id;
 
-typedef struct geometry {
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Run of a geometry's triangles that is culled as a unit. Bounds are in geometry local space
+typedef struct meshlet {
+    v4s sphere;             // Bounding sphere center (xyz) & radius (w)
+    v4s cone;               // Normal cone axis (xyz) & cutoff (w), a cutoff of 1 is never backfacing
+    u32 start_index;        // Index buffer offset, relative to the geometry until the scene places it
+    u32 index_count;
+} meshlet;
+
+#define GEOMETRY_MAX_LODS 4
+
+// Index & meshlet range of one level of detail. Error is the furthest, in geometry local
+// space, the level's surface strays from the full detail surface
+typedef struct geometry_lod {
     u32 start_index;
     u32 index_count;
+    u32 meshlet_offset;     // Index of the level's first meshlet
+    u32 meshlet_count;
+    f32 error;
+} geometry_lod;
+
+typedef struct geometry {
+    u32 start_index;        // Full detail, same range as lods[0]
+    u32 index_count;
     i32 vertex_offset;
     f32 radius;
     v4s origin;
     v4s extent;
+    u32 lod_count;
+    u32 color_offset;       // First vertex color in the scene color buffer, INVALID_ID when the geometry has none
+    u32 index_type;         // INDEX_TYPE_U16 geometries index into the 16 bit index buffer, index ranges are in its elements
+    geometry_lod lods[GEOMETRY_MAX_LODS];   // Full detail first, increasing error
 } geometry;
 
+// Rows of an affine model matrix, the bottom row is always (0, 0, 0, 1). Shaders derive the
+// normal matrix from the cofactors of the upper 3x3 instead of inverting a mat4 per vertex
+typedef struct affine_transform {
+    v4s rows[3];
+} affine_transform;
+
 typedef struct object {
     u32 pipe_id;            // Pipeline shader object index
     u32 mat_id;             // Material instance index
     u32 geo_id;             // Geometry index
     u32 transform_id;       // Transform index
+    u32 group_id;           // Instance group index, INVALID_ID when the object is drawn alone
 } object;
+
+// Objects that share a pipeline, material & geometry. They are contiguous in the object buffer
+// & drawn with one instanced draw per level of detail instead of per meshlet draws
+typedef struct instance_group {
+    u32 pipe_id;
+    u32 mat_id;
+    u32 geo_id;
+    u32 first_object;
+    u32 object_count;
+    u32 first_level;    // First of its levels of detail among those of every group, see pipe_range
+} instance_group;
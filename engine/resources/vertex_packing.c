@@ -0,0 +1,92 @@
+#include "vertex_packing.h"
+
+#include <math.h>
+
+static u16 pack_unorm16(f32 value);
+static u16 pack_snorm16(f32 value);
+static u16 f32_to_f16(f32 value);
+
+packed_position position_pack(v3s position, v4s origin, v4s extent) {
+    packed_position packed = {.padding = 0};
+    for (u32 i = 0; i < 3; ++i) {
+        // Flat axes decode to the origin whatever is stored
+        f32 t = (extent.raw[i] > 0.0f) ? (position.raw[i] - origin.raw[i]) / (2.0f * extent.raw[i]) + 0.5f : 0.0f;
+        packed.position[i] = pack_unorm16(t);
+    }
+    return packed;
+}
+
+packed_attributes attributes_pack(const vertex* v) {
+    packed_attributes packed;
+
+    // Octahedral: project onto the octahedron & fold the lower half over the upper one
+    v3s n = v->normal;
+    f32 l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    f32 x = (l1 > 0.0f) ? n.x / l1 : 0.0f;
+    f32 y = (l1 > 0.0f) ? n.y / l1 : 0.0f;
+    if (n.z < 0.0f) {
+        f32 folded_x = (1.0f - fabsf(y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+        f32 folded_y = (1.0f - fabsf(x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    packed.normal = (u32)pack_snorm16(x) | ((u32)pack_snorm16(y) << 16);
+    packed.uv = (u32)f32_to_f16(v->uv_x) | ((u32)f32_to_f16(v->uv_y) << 16);
+    return packed;
+}
+
+u32 color_pack(v4s color) {
+    u32 packed = 0;
+    for (u32 i = 0; i < 4; ++i) {
+        f32 c = glm_clamp(color.raw[i], 0.0f, 1.0f);
+        packed |= (u32)roundf(c * 255.0f) << (8 * i);
+    }
+    return packed;
+}
+
+static u16 pack_unorm16(f32 value) {
+    return (u16)roundf(glm_clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+static u16 pack_snorm16(f32 value) {
+    return (u16)(i16)roundf(glm_clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+// Rounds to nearest, out of range values become infinity & tiny values flush to zero
+static u16 f32_to_f16(f32 value) {
+    union {
+        f32 f;
+        u32 u;
+    } bits = {.f = value};
+    u32 sign = (bits.u >> 16) & 0x8000;
+    u32 f32_exponent = (bits.u >> 23) & 0xFF;
+    u32 mantissa = bits.u & 0x7FFFFF;
+    if (f32_exponent == 0xFF) {
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    }
+
+    i32 exponent = (i32)f32_exponent - 127 + 15;
+    if (exponent >= 31) {
+        return sign | 0x7C00;
+    }
+    if (exponent <= 0) {
+        // Subnormal half
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        u32 shift = 14 - exponent;
+        u32 half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    // A carry out of the mantissa correctly bumps the exponent
+    u32 half = sign | ((u32)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return half;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "defines.h"
+#include "math/math_types.h"
+
+/** NOTE: Vertex packing
+ * Positions are stored relative to the geometry's bounding box (origin & extent as in
+ * geometry) so 16 bits per axis cover the geometry at 1/65535th of its size. Normals are
+ * octahedral encoded, uvs are half floats & colors RGBA8. unpack_vertex in
+ * input_structures.glsl decodes them.
+ */
+
+packed_position position_pack(v3s position, v4s origin, v4s extent);
+
+packed_attributes attributes_pack(const vertex* v);
+
+u32 color_pack(v4s color);
@@ -5,6 +5,7 @@
 
 #include "core/etstring.h"
 #include "core/logger.h"
+#include "core/asserts.h"
 
 // TEMP: Until events refactor
 #include "core/events.h"
@@ -17,6 +18,7 @@
 #include "resources/image_manager.h"
 #include "resources/resource_private.h"
 #include "resources/material.h"
+#include "resources/vertex_packing.h"
 
 #include "renderer/src/vk_types.h"
 #include "renderer/src/renderer.h"
@@ -24,11 +26,15 @@
 #include "renderer/src/utilities/vkutils.h"
 #include "renderer/src/image.h"
 #include "renderer/src/buffer.h"
+#include "renderer/src/staging.h"
 #include "renderer/src/shader.h"
 #include "renderer/src/pipeline.h"
+#include "renderer/src/depth_pyramid.h"
 
 // TEMP: Until a math library is situated
+#include <float.h>
 #include <math.h>
+#include <stdlib.h>
 // TEMP: END
 
 // TEMP: Until events refactor
@@ -38,6 +44,29 @@ static b8 scene_on_key_event(u16 code, void* scne, event_data data);
 static b8 scene_renderer_init(scene* scene, scene_config config);
 static void scene_renderer_shutdown(scene* scene, renderer_state* state);
 
+static void extract_frustum_planes(m4s m, v4s planes[6]);
+static affine_transform transform_pack(m4s m);
+static instance_group* instance_groups_build(object* objects);
+static void transform_objects_build(scene* scene);
+static int object_compare(const void* a, const void* b);
+static u32 pipe_ranges_build(object* objects, instance_group* groups, geometry* geometries, pipe_range* ranges, u32 pipe_count);
+static f32 light_range(v4s color);
+static v4s object_world_sphere(scene* scene, object obj);
+static v4s world_bounds(scene* scene);
+static m4s sun_view_matrix(scene* scene);
+static void shadow_dirty_add(scene* scene, u32 transform_id);
+static VkRect2D cascade_texel_rect(shadow_cascade cascade, v4s rect);
+static void shadow_cascades_fit(scene* scene, m4s view, f32 aspect_ratio);
+static void transform_upload(scene* scene, VkCommandBuffer cmd);
+
+static void material_draws_barrier(scene* scene, VkCommandBuffer cmd);
+static void cluster_draw_generation(scene* scene, VkCommandBuffer cmd, b8 late);
+static void scan_barrier(scene* scene, VkCommandBuffer cmd);
+static u32 scan_block_count(u32 count);
+static void bind_index_buffer(scene* scene, VkCommandBuffer cmd, index_type type);
+static void depth_prepass(renderer_state* state, scene* scene, VkCommandBuffer cmd, b8 late);
+static void light_culling(renderer_state* state, scene* scene, VkCommandBuffer cmd);
+
 // TODO: Remove, textures will be set when loading for now, until any kind of streaming
 // is implemented, if it ever is
 void scene_texture_set(scene* scene, u32 tex_id, u32 img_id, u32 sampler_id);
@@ -51,12 +80,26 @@ b8 scene_init(scene** scn, scene_config config) {
 
     // NOTE: This will be passed a config when serialization is implemented
     scene->data.ambient_color = (v4s) { .raw = {1.f, 1.f, 1.f, .1f}};
-    scene->data.light.color   = (v4s) { .raw = {1.f, 1.f, 1.f, 5.f}};
     scene->data.sun.color     = (v4s) { .raw = {1.f, 1.f, 1.f, 10.f}};
     scene->data.sun.direction = (v4s) { .raw = {0.00001f, -1.f, 0.00001f, 0.0f}};
     // scene->data.sun.direction = (v4s) { .raw = {-0.707107f, -0.707107f, 0.0f, 0.0f}};
 
     scene->data.debug_view = DEBUG_VIEW_TYPE_OFF;
+
+    scene->shadow_cascade_count = glm_clamp(config.shadow_cascade_count, 1, MAX_SHADOW_CASCADES);
+    scene->shadow_distance = config.shadow_distance;
+    scene->data.cascade_count = scene->shadow_cascade_count;
+    scene->shadow_receiver_culling = config.shadow_receiver_culling;
+    scene->data.shadow_filter = glm_min(config.shadow_filter, SHADOW_FILTER_MAX - 1);
+    scene->data.sun_angular_radius = 0.01f;
+    scene->shadow_map_initialized = false;
+    scene->shadow_cache_valid = false;
+    scene->shadow_casters_moved = false;
+    scene->dropped_draws = 0;
+    scene->overflowed_light_clusters = 0;
+    scene->shadow_dirty_version = 0;
+    scene->shadow_fit_version = 0;
+    scene->shadow_frame = 0;
     
     import_payload* payload = config.import_payload;
 
@@ -65,21 +108,69 @@ b8 scene_init(scene** scn, scene_config config) {
     geometry* geometries = dynarray_create(geo_count, sizeof(geometry));
     dynarray_resize((void**)&geometries, geo_count);
 
-    vertex* vertices = dynarray_create(payload->vertex_count, sizeof(vertex));
+    packed_position* positions = dynarray_create(payload->vertex_count, sizeof(packed_position));
+    packed_attributes* attributes = dynarray_create(payload->vertex_count, sizeof(packed_attributes));
+    u32* colors = dynarray_create(1, sizeof(u32));
     u32* indices = dynarray_create(payload->index_count, sizeof(u32));
+    u16* indices_u16 = dynarray_create(payload->index_count, sizeof(u16));
+    meshlet* meshlets = dynarray_create(1, sizeof(meshlet));
 
     for (u32 i = 0; i < geo_count; ++i) {
+        import_geometry* import_geo = &payload->geometries[i];
+        u32 vertex_count = dynarray_length(import_geo->vertices);
+        // NOTE: Indices are relative to the geometry's vertex_offset, so any geometry with
+        // fewer than 65536 vertices fits the 16 bit index buffer
+        index_type type = (vertex_count <= UINT16_MAX) ? INDEX_TYPE_U16 : INDEX_TYPE_U32;
+        u32 start_index = (type == INDEX_TYPE_U16) ? dynarray_length(indices_u16) : dynarray_length(indices);
+        u32 meshlet_offset = dynarray_length(meshlets);
         geometries[i] = (geometry) {
-            .start_index = dynarray_length(indices),
-            .index_count = dynarray_length(payload->geometries[i].indices),
-            .vertex_offset = dynarray_length(vertices),
-            .radius = payload->geometries[i].radius,
-            .origin = payload->geometries[i].origin,
-            .extent = payload->geometries[i].extent,
+            .start_index = start_index + import_geo->lods[0].start_index,
+            .index_count = import_geo->lods[0].index_count,
+            .vertex_offset = dynarray_length(positions),
+            .radius = import_geo->radius,
+            .origin = import_geo->origin,
+            .extent = import_geo->extent,
+            .lod_count = import_geo->lod_count,
+            .color_offset = import_geo->has_color ? dynarray_length(colors) : INVALID_ID,
+            .index_type = type,
         };
+        // Level of detail ranges become offsets into the scene index buffer of the geometry's type & meshlet buffer
+        for (u32 j = 0; j < import_geo->lod_count; ++j) {
+            geometries[i].lods[j] = import_geo->lods[j];
+            geometries[i].lods[j].start_index += start_index;
+            geometries[i].lods[j].meshlet_offset += meshlet_offset;
+        }
+
+        // Meshlet index ranges become offsets into the scene index buffer
+        u32 meshlet_count = dynarray_length(import_geo->meshlets);
+        u64 meshlet_start = dynarray_grow((void**)&meshlets, meshlet_count);
+        for (u32 j = 0; j < meshlet_count; ++j) {
+            meshlets[meshlet_start + j] = import_geo->meshlets[j];
+            meshlets[meshlet_start + j].start_index += start_index;
+        }
 
-        dynarray_append_vertex(&vertices, payload->geometries[i].vertices);
-        dynarray_append_u32(&indices, payload->geometries[i].indices);
+        // Quantized against the geometry's bounds, unpack_vertex decodes them
+        u64 vertex_start = dynarray_grow((void**)&positions, vertex_count);
+        dynarray_grow((void**)&attributes, vertex_count);
+        for (u32 j = 0; j < vertex_count; ++j) {
+            positions[vertex_start + j] = position_pack(import_geo->vertices[j].position, import_geo->origin, import_geo->extent);
+            attributes[vertex_start + j] = attributes_pack(&import_geo->vertices[j]);
+        }
+        if (import_geo->has_color) {
+            u64 color_start = dynarray_grow((void**)&colors, vertex_count);
+            for (u32 j = 0; j < vertex_count; ++j) {
+                colors[color_start + j] = color_pack(import_geo->vertices[j].color);
+            }
+        }
+        if (type == INDEX_TYPE_U16) {
+            u32 index_count = dynarray_length(import_geo->indices);
+            u64 index_start = dynarray_grow((void**)&indices_u16, index_count);
+            for (u32 j = 0; j < index_count; ++j) {
+                indices_u16[index_start + j] = (u16)import_geo->indices[j];
+            }
+        } else {
+            dynarray_append_u32(&indices, import_geo->indices);
+        }
     }
 
     // Remove default pipelines without empty instance arrays
@@ -96,6 +187,7 @@ b8 scene_init(scene** scn, scene_config config) {
                 .inst_count = instance_count,
                 .instances = payload->pipelines[i].instances,
                 .transparent = payload->pipelines[i].transparent,
+                .alpha_tested = payload->pipelines[i].alpha_tested,
             };
             pipe_index_to_id[i] = dynarray_length(mat_pipe_configs);
             dynarray_push((void**)&mat_pipe_configs, &config);
@@ -103,13 +195,20 @@ b8 scene_init(scene** scn, scene_config config) {
     }
 
     // Change nodes into objects and transforms for the meshes
-    m4s* transforms = dynarray_create(1, sizeof(m4s));
+    affine_transform* transforms = dynarray_create(1, sizeof(affine_transform));
     object* objects = dynarray_create(1, sizeof(object));
     u32 node_count = dynarray_length(payload->nodes);
     for (u32 i = 0; i < node_count; ++i) {
-        if (payload->nodes[i].has_mesh) {
+        if (!payload->nodes[i].has_mesh) {
+            continue;
+        }
+        // EXT_mesh_gpu_instancing nodes have an object per primitive per instance
+        m4s* instance_transforms = payload->nodes[i].instance_transforms;
+        u32 instance_count = instance_transforms ? dynarray_length(instance_transforms) : 1;
+        for (u32 k = 0; k < instance_count; ++k) {
             u32 transform_index = dynarray_length(transforms);
-            dynarray_push((void**)&transforms, &payload->nodes[i].world_transform);
+            affine_transform transform = transform_pack(instance_transforms ? instance_transforms[k] : payload->nodes[i].world_transform);
+            dynarray_push((void**)&transforms, &transform);
 
             import_mesh mesh = payload->meshes[payload->nodes[i].mesh_index];
             u64 object_start = dynarray_grow((void**)&objects, mesh.count);
@@ -120,16 +219,48 @@ b8 scene_init(scene** scn, scene_config config) {
                     .mat_id = payload->mat_index_to_mat_id[material_index].inst_id,
                     .geo_id = mesh.geometry_indices[j],
                     .transform_id = transform_index,
+                    .group_id = INVALID_ID,
                 };
             }
         }
     }
+    instance_group* instance_groups = instance_groups_build(objects);
+
+    // The light following the camera, placed in scene_update, then the imported point lights
+    point_light* lights = dynarray_create(1, sizeof(point_light));
+    point_light camera_light = {
+        .color = (v4s) { .raw = {1.f, 1.f, 1.f, 5.f}},
+    };
+    camera_light.position.w = light_range(camera_light.color);
+    dynarray_push((void**)&lights, &camera_light);
+    u32 light_count = dynarray_length(payload->lights);
+    if (light_count > MAX_POINT_LIGHTS - 1) {
+        ETWARN("Scene has %u point lights, only the first %u are used.", light_count, MAX_POINT_LIGHTS - 1);
+        light_count = MAX_POINT_LIGHTS - 1;
+    }
+    for (u32 i = 0; i < light_count; ++i) {
+        point_light light = {
+            .color = payload->lights[i].color,
+            .position = payload->lights[i].position,
+        };
+        light.position.w = (payload->lights[i].range > 0.0f) ? payload->lights[i].range : light_range(light.color);
+        dynarray_push((void**)&lights, &light);
+    }
 
-    scene->vertices = vertices;
+    scene->positions = positions;
+    scene->attributes = attributes;
+    scene->colors = colors;
     scene->indices = indices;
+    scene->indices_u16 = indices_u16;
     scene->objects = objects;
+    scene->instance_groups = instance_groups;
+    scene->lights = lights;
     scene->transforms = transforms;
     scene->geometries = geometries;
+    scene->meshlets = meshlets;
+    transform_objects_build(scene);
+    scene->bounds = world_bounds(scene);
+    scene->dirty_transforms = dynarray_create(1, sizeof(u32));
 
     u32 mat_pipe_count = dynarray_length(mat_pipe_configs);
     scene->mat_pipe_count = mat_pipe_count;
@@ -157,10 +288,20 @@ void scene_shutdown(scene* scene) {
     camera_destroy(&scene->cam);
 
     dynarray_destroy(scene->indices);
-    dynarray_destroy(scene->vertices);
+    dynarray_destroy(scene->indices_u16);
+    dynarray_destroy(scene->positions);
+    dynarray_destroy(scene->attributes);
+    dynarray_destroy(scene->colors);
     dynarray_destroy(scene->geometries);
+    dynarray_destroy(scene->meshlets);
+    u32 transform_count = dynarray_length(scene->transforms);
+    etfree(scene->transform_object_offsets, sizeof(u32) * (transform_count + 1), MEMORY_TAG_SCENE);
+    etfree(scene->transform_objects, sizeof(u32) * dynarray_length(scene->objects), MEMORY_TAG_SCENE);
     dynarray_destroy(scene->transforms);
+    dynarray_destroy(scene->dirty_transforms);
     dynarray_destroy(scene->objects);
+    dynarray_destroy(scene->instance_groups);
+    dynarray_destroy(scene->lights);
 
     import_payload_destroy(&scene->payload);
     
@@ -174,6 +315,438 @@ static b8 sun_pov = false;
 static b8 sun_pov_persp = false;
 // TEMP: END
 
+/**
+ * Gribb & Hartmann plane extraction for a [0, 1] depth range clip space. Works for reverse z
+ * as near & far only swap which plane they come from. Planes are normalized with their
+ * normals pointing into the frustum.
+ */
+static void extract_frustum_planes(m4s m, v4s planes[6]) {
+    v4s rows[4];
+    for (u32 i = 0; i < 4; ++i) {
+        rows[i] = (v4s){.raw = {m.raw[0][i], m.raw[1][i], m.raw[2][i], m.raw[3][i]}};
+    }
+    planes[0] = glms_vec4_add(rows[3], rows[0]);    // Left
+    planes[1] = glms_vec4_sub(rows[3], rows[0]);    // Right
+    planes[2] = glms_vec4_add(rows[3], rows[1]);    // Bottom
+    planes[3] = glms_vec4_sub(rows[3], rows[1]);    // Top
+    planes[4] = rows[2];                            // z >= 0
+    planes[5] = glms_vec4_sub(rows[3], rows[2]);    // z <= w
+    for (u32 i = 0; i < 6; ++i) {
+        f32 length = glms_vec3_norm(glms_vec3(planes[i]));
+        planes[i] = glms_vec4_scale(planes[i], 1.0f / length);
+    }
+}
+
+// Drops the bottom row of an affine cglm (column major) matrix
+static affine_transform transform_pack(m4s m) {
+    affine_transform packed;
+    for (u32 i = 0; i < 3; ++i) {
+        packed.rows[i] = (v4s){.raw = {m.raw[0][i], m.raw[1][i], m.raw[2][i], m.raw[3][i]}};
+    }
+    return packed;
+}
+
+// Sorts objects by pipeline, material & geometry & groups every run of at least
+// INSTANCE_GROUP_MIN_OBJECTS equal objects. Returns a dynarray of the groups
+static instance_group* instance_groups_build(object* objects) {
+    u32 object_count = dynarray_length(objects);
+    qsort(objects, object_count, sizeof(object), object_compare);
+
+    instance_group* groups = dynarray_create(1, sizeof(instance_group));
+    u32 run_start = 0;
+    while (run_start < object_count) {
+        u32 run_end = run_start + 1;
+        while (run_end < object_count && object_compare(&objects[run_start], &objects[run_end]) == 0) {
+            run_end++;
+        }
+        if (run_end - run_start >= INSTANCE_GROUP_MIN_OBJECTS) {
+            u32 group_id = dynarray_length(groups);
+            instance_group group = {
+                .pipe_id = objects[run_start].pipe_id,
+                .mat_id = objects[run_start].mat_id,
+                .geo_id = objects[run_start].geo_id,
+                .first_object = run_start,
+                .object_count = run_end - run_start,
+            };
+            dynarray_push((void**)&groups, &group);
+            for (u32 i = run_start; i < run_end; ++i) {
+                objects[i].group_id = group_id;
+            }
+        }
+        run_start = run_end;
+    }
+    return groups;
+}
+
+// Counting sort of the object indices by transform, so moving a transform visits only its objects
+static void transform_objects_build(scene* scene) {
+    u32 transform_count = dynarray_length(scene->transforms);
+    u32 object_count = dynarray_length(scene->objects);
+    u32* offsets = etallocate(sizeof(u32) * (transform_count + 1), MEMORY_TAG_SCENE);
+    u32* indices = etallocate(sizeof(u32) * object_count, MEMORY_TAG_SCENE);
+    etzero_memory(offsets, sizeof(u32) * (transform_count + 1));
+    for (u32 i = 0; i < object_count; ++i) {
+        offsets[scene->objects[i].transform_id + 1]++;
+    }
+    for (u32 i = 0; i < transform_count; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+    // Fills each transform's range from its end, leaving the offsets at their starts
+    for (u32 i = object_count; i > 0; --i) {
+        indices[--offsets[scene->objects[i - 1].transform_id + 1]] = i - 1;
+    }
+    for (u32 i = 0; i < transform_count; ++i) {
+        offsets[i] = offsets[i + 1];
+    }
+    offsets[transform_count] = object_count;
+    scene->transform_object_offsets = offsets;
+    scene->transform_objects = indices;
+}
+
+static int object_compare(const void* a, const void* b) {
+    const object* object_a = a;
+    const object* object_b = b;
+    if (object_a->pipe_id != object_b->pipe_id) {
+        return (object_a->pipe_id > object_b->pipe_id) - (object_a->pipe_id < object_b->pipe_id);
+    }
+    if (object_a->mat_id != object_b->mat_id) {
+        return (object_a->mat_id > object_b->mat_id) - (object_a->mat_id < object_b->mat_id);
+    }
+    return (object_a->geo_id > object_b->geo_id) - (object_a->geo_id < object_b->geo_id);
+}
+
+// Expects objects & instance groups sorted by pipeline. Finds each pipeline's objects & instance group
+// levels of detail, giving every group the first of its levels. Returns the level count of all groups
+static u32 pipe_ranges_build(object* objects, instance_group* groups, geometry* geometries, pipe_range* ranges, u32 pipe_count) {
+    u32 object_count = dynarray_length(objects);
+    u32 group_count = dynarray_length(groups);
+    u32 object_index = 0;
+    u32 group_index = 0;
+    u32 level_count = 0;
+    for (u32 i = 0; i < pipe_count; ++i) {
+        ranges[i].first_object = object_index;
+        while (object_index < object_count && objects[object_index].pipe_id == i) {
+            object_index++;
+        }
+        ranges[i].object_end = object_index;
+
+        // Levels a geometry lacks get no draw, so a group takes only as many as it has
+        u32 pipe_levels[DRAW_INDEX_TYPE_COUNT] = {0};
+        ranges[i].first_level = level_count;
+        while (group_index < group_count && groups[group_index].pipe_id == i) {
+            geometry* geo = &geometries[groups[group_index].geo_id];
+            groups[group_index].first_level = level_count;
+            level_count += geo->lod_count;
+            pipe_levels[geo->index_type] += geo->lod_count;
+            group_index++;
+        }
+        ranges[i].level_end = level_count;
+        for (u32 j = 0; j < DRAW_INDEX_TYPE_COUNT; ++j) {
+            if (pipe_levels[j] > MAX_DRAW_COMMANDS) {
+                ETWARN("Material pipeline %u has more instanced draws than fit its draw buffer.", i);
+            }
+        }
+    }
+    return level_count;
+}
+
+// Distance at which the inverse square falloff of a light without a range drops below LIGHT_CUTOFF_RADIANCE
+static f32 light_range(v4s color) {
+    f32 peak = glm_max(color.x, glm_max(color.y, color.z)) * color.w;
+    return sqrtf(peak / LIGHT_CUTOFF_RADIANCE);
+}
+
+// World space bounding sphere of the object, matches world_bounding_sphere in culling.glsl
+static v4s object_world_sphere(scene* scene, object obj) {
+    affine_transform t = scene->transforms[obj.transform_id];
+    geometry geo = scene->geometries[obj.geo_id];
+    v4s origin = glms_vec4(glms_vec3(geo.origin), 1.0f);
+    v3s center = {.raw = {glms_vec4_dot(t.rows[0], origin), glms_vec4_dot(t.rows[1], origin), glms_vec4_dot(t.rows[2], origin)}};
+    f32 scale = 0.0f;
+    for (u32 j = 0; j < 3; ++j) {
+        v3s column = {.raw = {t.rows[0].raw[j], t.rows[1].raw[j], t.rows[2].raw[j]}};
+        scale = glm_max(scale, glms_vec3_norm(column));
+    }
+    return glms_vec4(center, geo.radius * scale);
+}
+
+// Bounding sphere of the world bounding spheres of every object
+static v4s world_bounds(scene* scene) {
+    v3s bounds_min = glms_vec3_broadcast(FLT_MAX);
+    v3s bounds_max = glms_vec3_broadcast(-FLT_MAX);
+    u32 object_count = dynarray_length(scene->objects);
+    for (u32 i = 0; i < object_count; ++i) {
+        v4s sphere = object_world_sphere(scene, scene->objects[i]);
+        v3s radius = glms_vec3_broadcast(sphere.w);
+        bounds_min = glms_vec3_minv(bounds_min, glms_vec3_sub(glms_vec3(sphere), radius));
+        bounds_max = glms_vec3_maxv(bounds_max, glms_vec3_add(glms_vec3(sphere), radius));
+    }
+    if (!object_count) {
+        return glms_vec4_zero();
+    }
+    v3s center = glms_vec3_scale(glms_vec3_add(bounds_min, bounds_max), 0.5f);
+    return glms_vec4(center, glms_vec3_distance(center, bounds_max));
+}
+
+// Looks down the sun direction from the origin, shadow cascades are boxes in this space
+static m4s sun_view_matrix(scene* scene) {
+    return glms_look(
+        (v3s){ .raw = {0.0f, 0.0f, 0.0f}},
+        glms_vec3(scene->data.sun.direction),
+        (v3s){ .raw = {0.0f, 1.0f, 0.0f}}
+    );
+}
+
+// Adds the shadows of the objects using the transform to the region of the shadow map to rerender.
+// Orthographic along z, so a caster's shadow stays inside the light space rect of its bounding sphere
+static void shadow_dirty_add(scene* scene, u32 transform_id) {
+    m4s sun_view = sun_view_matrix(scene);
+    u32 object_end = scene->transform_object_offsets[transform_id + 1];
+    for (u32 i = scene->transform_object_offsets[transform_id]; i < object_end; ++i) {
+        v4s sphere = object_world_sphere(scene, scene->objects[scene->transform_objects[i]]);
+        v3s center = glms_mat4_mulv3(sun_view, glms_vec3(sphere), 1.0f);
+        v4s rect = {.raw = {center.x - sphere.w, center.y - sphere.w, center.x + sphere.w, center.y + sphere.w}};
+        if (scene->shadow_casters_moved) {
+            rect.x = glm_min(rect.x, scene->shadow_dirty_rect.x);
+            rect.y = glm_min(rect.y, scene->shadow_dirty_rect.y);
+            rect.z = glm_max(rect.z, scene->shadow_dirty_rect.z);
+            rect.w = glm_max(rect.w, scene->shadow_dirty_rect.w);
+        }
+        scene->shadow_dirty_rect = rect;
+        scene->shadow_casters_moved = true;
+        scene->shadow_dirty_version++;
+
+        // Casters leaving the scene bounds change how far every cascade reaches toward the sun
+        f32 reach = glms_vec3_distance(glms_vec3(sphere), glms_vec3(scene->bounds)) + sphere.w;
+        if (reach > scene->bounds.w) {
+            scene->bounds.w = reach;
+            scene->shadow_cache_valid = false;
+        }
+    }
+}
+
+void scene_transform_set(scene* scene, u32 transform_id, m4s transform) {
+    shadow_dirty_add(scene, transform_id);
+    scene->transforms[transform_id] = transform_pack(transform);
+    shadow_dirty_add(scene, transform_id);
+    dynarray_push((void**)&scene->dirty_transforms, &transform_id);
+}
+
+// Shadow map texels of the cascade covering a light space rect, rounded out to whole tiles
+static VkRect2D cascade_texel_rect(shadow_cascade cascade, v4s rect) {
+    f32 texels_per_unit = (f32)SHADOW_CASCADE_RESOLUTION / (cascade.max.x - cascade.min.x);
+    // NOTE: The projection inverts y, the cascade's max y is the first row
+    f32 x0 = (rect.x - cascade.min.x) * texels_per_unit;
+    f32 x1 = (rect.z - cascade.min.x) * texels_per_unit;
+    f32 y0 = (cascade.max.y - rect.w) * texels_per_unit;
+    f32 y1 = (cascade.max.y - rect.y) * texels_per_unit;
+    i32 tile_x0 = (i32)glm_clamp(floorf(x0 / SHADOW_TILE_SIZE), 0.0f, SHADOW_CASCADE_RESOLUTION / SHADOW_TILE_SIZE);
+    i32 tile_x1 = (i32)glm_clamp(ceilf(x1 / SHADOW_TILE_SIZE), 0.0f, SHADOW_CASCADE_RESOLUTION / SHADOW_TILE_SIZE);
+    i32 tile_y0 = (i32)glm_clamp(floorf(y0 / SHADOW_TILE_SIZE), 0.0f, SHADOW_CASCADE_RESOLUTION / SHADOW_TILE_SIZE);
+    i32 tile_y1 = (i32)glm_clamp(ceilf(y1 / SHADOW_TILE_SIZE), 0.0f, SHADOW_CASCADE_RESOLUTION / SHADOW_TILE_SIZE);
+    VkRect2D texels = {
+        .offset = {tile_x0 * SHADOW_TILE_SIZE, tile_y0 * SHADOW_TILE_SIZE},
+        .extent = {
+            (u32)glm_max(tile_x1 - tile_x0, 0) * SHADOW_TILE_SIZE,
+            (u32)glm_max(tile_y1 - tile_y0, 0) * SHADOW_TILE_SIZE,
+        },
+    };
+    return texels;
+}
+
+// Part of a cascade's box its casters are culled against. The side facing the sun is kept, with
+// receiver culling the rest is clipped to the light space bounds of the receivers
+static shadow_cascade cascade_caster_box(scene* scene, shadow_cascade cascade, shadow_cascade receivers) {
+    if (!scene->shadow_receiver_culling) {
+        return cascade;
+    }
+    shadow_cascade box = {
+        .min = glms_vec3_maxv(cascade.min, receivers.min),
+        .max = {.raw = {glm_min(cascade.max.x, receivers.max.x), glm_min(cascade.max.y, receivers.max.y), cascade.max.z}},
+    };
+    return box;
+}
+
+static b8 caster_box_contains(shadow_cascade outer, shadow_cascade inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+        inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+#ifdef _DEBUG
+// Checks a partial shadow update against the tiles the moved casters overlap, tested one tile at a
+// time: only the layers they overlap are rerendered & the render area is the bounds of those tiles
+static void shadow_partial_update_check(scene* scene) {
+    u32 tiles = SHADOW_CASCADE_RESOLUTION / SHADOW_TILE_SIZE;
+    v4s rect = scene->shadow_dirty_rect;
+    u32 mask = 0;
+    u32 tile_x0 = tiles, tile_y0 = tiles, tile_x1 = 0, tile_y1 = 0;
+    for (u32 i = 0; i < scene->shadow_cascade_count; ++i) {
+        shadow_cascade cascade = scene->cascades[i];
+        f32 texels_per_unit = (f32)SHADOW_CASCADE_RESOLUTION / (cascade.max.x - cascade.min.x);
+        f32 x0 = (rect.x - cascade.min.x) * texels_per_unit;
+        f32 x1 = (rect.z - cascade.min.x) * texels_per_unit;
+        f32 y0 = (cascade.max.y - rect.w) * texels_per_unit;
+        f32 y1 = (cascade.max.y - rect.y) * texels_per_unit;
+        for (u32 y = 0; y < tiles; ++y) {
+            for (u32 x = 0; x < tiles; ++x) {
+                b8 overlaps = (f32)(x * SHADOW_TILE_SIZE) < x1 && (f32)((x + 1) * SHADOW_TILE_SIZE) > x0 &&
+                    (f32)(y * SHADOW_TILE_SIZE) < y1 && (f32)((y + 1) * SHADOW_TILE_SIZE) > y0;
+                if (overlaps) {
+                    mask |= 1u << i;
+                    tile_x0 = glm_min(tile_x0, x);
+                    tile_y0 = glm_min(tile_y0, y);
+                    tile_x1 = glm_max(tile_x1, x + 1);
+                    tile_y1 = glm_max(tile_y1, y + 1);
+                }
+            }
+        }
+    }
+    ETASSERT_MESSAGE(mask == scene->shadow_cascade_mask, "Moved casters rerender other shadow map layers than they overlap.");
+    if (mask) {
+        VkRect2D area = scene->shadow_render_area;
+        ETASSERT_MESSAGE(
+            area.offset.x == (i32)(tile_x0 * SHADOW_TILE_SIZE) && area.offset.y == (i32)(tile_y0 * SHADOW_TILE_SIZE) &&
+            area.extent.width == (tile_x1 - tile_x0) * SHADOW_TILE_SIZE && area.extent.height == (tile_y1 - tile_y0) * SHADOW_TILE_SIZE,
+            "Moved casters rerender other shadow map tiles than they overlap.");
+    }
+}
+#endif
+
+/**
+ * Fits an orthographic sun view to each cascade's slice of the camera frustum, out to shadow_distance.
+ * Each cascade covers the bounding sphere of its slice, whose size does not change as the camera
+ * rotates, & the sphere's center is snapped to whole shadow map texels so the cascades do not
+ * shimmer as the camera moves. The side facing the sun extends to the scene bounds to keep the
+ * casters between the sun & the cascade.
+ *
+ * The shadow map is cached: a layer is only rerendered when its fitted box changed or casters
+ * moved inside it, in which case only the tiles of the moved casters are. Cascade i > 0 picks up a
+ * new box every 2^(i - 1) frames, far cascades cover less of the screen per texel & lag unnoticed.
+ * Moving the sun or growing the scene bounds rerenders every layer.
+ *
+ * Casters are culled against a caster box per cascade, with receiver culling its box clipped to the
+ * light space bounds of the camera frustum out to shadow_distance. A cached layer holds the casters
+ * of the caster box it was rendered with, so moving the camera only rerenders the layers whose
+ * clipped box reaches past it. The layer's caster box then grows to cover both, near cascades lie
+ * inside the receivers & are never clipped.
+ */
+static void shadow_cascades_fit(scene* scene, m4s view, f32 aspect_ratio) {
+    m4s sun_view = sun_view_matrix(scene);
+    v3s forward = {.raw = {-view.raw[0][2], -view.raw[1][2], -view.raw[2][2]}};
+    f32 tan_y = tanf(glm_rad(CAMERA_FOV_Y) * 0.5f);
+    f32 tan_x = tan_y * aspect_ratio;
+    // Squared distance from the view axis of a frustum corner at view depth 1
+    f32 corner_k = tan_x * tan_x + tan_y * tan_y;
+
+    v3s scene_center = glms_mat4_mulv3(sun_view, glms_vec3(scene->bounds), 1.0f);
+    f32 scene_sun_side = scene_center.z + scene->bounds.w;
+
+    // Light space bounds of the receivers, fragments past the shadow distance are not shadowed
+    v3s right = {.raw = {view.raw[0][0], view.raw[1][0], view.raw[2][0]}};
+    v3s up = {.raw = {view.raw[0][1], view.raw[1][1], view.raw[2][1]}};
+    shadow_cascade receivers = {.min = glms_vec3_broadcast(FLT_MAX), .max = glms_vec3_broadcast(-FLT_MAX)};
+    for (u32 i = 0; i < 8; ++i) {
+        f32 depth = (i & 4) ? scene->shadow_distance : CAMERA_Z_NEAR;
+        v3s corner = glms_vec3_add(scene->cam.position, glms_vec3_scale(forward, depth));
+        corner = glms_vec3_add(corner, glms_vec3_scale(right, ((i & 1) ? tan_x : -tan_x) * depth));
+        corner = glms_vec3_add(corner, glms_vec3_scale(up, ((i & 2) ? tan_y : -tan_y) * depth));
+        corner = glms_mat4_mulv3(sun_view, corner, 1.0f);
+        receivers.min = glms_vec3_minv(receivers.min, corner);
+        receivers.max = glms_vec3_maxv(receivers.max, corner);
+    }
+
+    b8 rerender_all = !scene->shadow_cache_valid ||
+        !glms_vec4_eqv(scene->shadow_sun_direction, scene->data.sun.direction);
+    scene->shadow_fit_version = scene->shadow_dirty_version;
+    u32 full_mask = 0;
+    u32 dirty_mask = 0;
+    VkRect2D dirty_area = {0};
+
+    f32 near = CAMERA_Z_NEAR;
+    f32 far = scene->shadow_distance;
+    f32 split_near = near;
+    for (u32 i = 0; i < scene->shadow_cascade_count; ++i) {
+        f32 t = (f32)(i + 1) / (f32)scene->shadow_cascade_count;
+        f32 log_split = near * powf(far / near, t);
+        f32 uniform_split = near + (far - near) * t;
+        f32 split_far = SHADOW_CASCADE_SPLIT_LAMBDA * log_split + (1.0f - SHADOW_CASCADE_SPLIT_LAMBDA) * uniform_split;
+        scene->data.cascade_splits.raw[i] = split_far;
+
+        // Smallest sphere through the near & far corners of the slice, centered on the view axis
+        f32 depth = glm_min(0.5f * (split_near + split_far) * (1.0f + corner_k), split_far);
+        f32 radius = sqrtf((split_far - depth) * (split_far - depth) + split_far * split_far * corner_k);
+        // NOTE: Rounded so float error does not change the texel size between frames
+        radius = ceilf(radius * 16.0f) / 16.0f;
+        v3s center = glms_vec3_add(scene->cam.position, glms_vec3_scale(forward, depth));
+
+        v3s sun_center = glms_mat4_mulv3(sun_view, center, 1.0f);
+        f32 texel = 2.0f * radius / (f32)SHADOW_CASCADE_RESOLUTION;
+        sun_center.x = floorf(sun_center.x / texel) * texel;
+        sun_center.y = floorf(sun_center.y / texel) * texel;
+
+        shadow_cascade fitted = {
+            .min = {.raw = {sun_center.x - radius, sun_center.y - radius, sun_center.z - radius}},
+            .max = {.raw = {sun_center.x + radius, sun_center.y + radius, glm_max(sun_center.z + radius, scene_sun_side)}},
+        };
+        split_near = split_far;
+
+        shadow_cascade cascade = scene->cascades[i];
+        shadow_cascade casters = scene->caster_boxes[i];
+        // Caster box the cached layer needs for this frame's receivers
+        shadow_cascade reached = cascade_caster_box(scene, cascade, receivers);
+        b8 moved = !glms_vec3_eqv(fitted.min, cascade.min) || !glms_vec3_eqv(fitted.max, cascade.max);
+        u32 period = i ? 1u << (i - 1) : 1;
+        if (rerender_all || (moved && ((scene->shadow_frame + i) % period) == 0)) {
+            cascade = fitted;
+            casters = cascade_caster_box(scene, cascade, receivers);
+            full_mask |= 1u << i;
+        } else if (!caster_box_contains(casters, reached)) {
+            // Casters the cached layer was culled without now shadow receivers
+            casters.min = glms_vec3_minv(casters.min, reached.min);
+            casters.max = glms_vec3_maxv(casters.max, reached.max);
+            full_mask |= 1u << i;
+        } else if (scene->shadow_casters_moved) {
+            VkRect2D area = cascade_texel_rect(cascade, scene->shadow_dirty_rect);
+            if (area.extent.width && area.extent.height) {
+                if (dirty_mask) {
+                    i32 x1 = glm_max(dirty_area.offset.x + (i32)dirty_area.extent.width, area.offset.x + (i32)area.extent.width);
+                    i32 y1 = glm_max(dirty_area.offset.y + (i32)dirty_area.extent.height, area.offset.y + (i32)area.extent.height);
+                    area.offset.x = glm_min(dirty_area.offset.x, area.offset.x);
+                    area.offset.y = glm_min(dirty_area.offset.y, area.offset.y);
+                    area.extent.width = x1 - area.offset.x;
+                    area.extent.height = y1 - area.offset.y;
+                }
+                dirty_area = area;
+                dirty_mask |= 1u << i;
+            }
+        }
+        scene->cascade_targets[i] = cascade;
+        scene->caster_box_targets[i] = casters;
+
+        // NOTE: Reverse z, depth is 1 on the side facing the sun. Y is inverted to match gltf axis
+        m4s projection = glms_ortho(cascade.min.x, cascade.max.x, cascade.min.y, cascade.max.y, -cascade.min.z, -cascade.max.z);
+        projection.raw[1][1] *= -1;
+        scene->data.cascade_viewprojs[i] = glms_mat4_mul(projection, sun_view);
+        // Shadow draws are culled against the caster box of each cascade they are drawn to
+        m4s caster_projection = glms_ortho(casters.min.x, casters.max.x, casters.min.y, casters.max.y, -casters.min.z, -casters.max.z);
+        extract_frustum_planes(glms_mat4_mul(caster_projection, sun_view), scene->data.cascade_frustum_planes[i]);
+    }
+
+    // Layers rerendered in full share the pass with the partially rerendered ones
+    scene->shadow_cascade_mask = full_mask | dirty_mask;
+    scene->data.shadow_cascade_mask = scene->shadow_cascade_mask;
+    if (full_mask) {
+        scene->shadow_render_area = (VkRect2D){.extent = {SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION}};
+    } else {
+        scene->shadow_render_area = dirty_area;
+    }
+#ifdef _DEBUG
+    if (!full_mask && scene->shadow_casters_moved) {
+        shadow_partial_update_check(scene);
+    }
+#endif
+}
+
 void scene_update(scene* scene, f64 dt) {
     renderer_state* state = scene->state;
     camera_update(&scene->cam, dt);
@@ -184,7 +757,7 @@ void scene_update(scene* scene, f64 dt) {
     m4s view = camera_get_view_matrix(&scene->cam);
     // NOTE: invert the Y direction on projection matrix so that we match gltf axis
     float aspect_ratio = ((f32)state->swapchain.image_extent.width/(f32)state->swapchain.image_extent.height);
-    m4s project = glms_perspective(glm_rad(70.f), aspect_ratio, 1000.f, 0.1f);
+    m4s project = glms_perspective(glm_rad(CAMERA_FOV_Y), aspect_ratio, CAMERA_Z_FAR, CAMERA_Z_NEAR);
     project.raw[1][1] *= -1;
     // NOTE: END
     // TODO: END
@@ -195,29 +768,23 @@ void scene_update(scene* scene, f64 dt) {
     scene->data.viewproj = glms_mat4_mul(project, view);
     scene->data.view_pos = glms_vec4(scene->cam.position, 1.0f);
 
-    m4s sun_view = glms_look(
-        (v3s){ .raw = {0.0f, 0.0f, 0.0f}},
-        glms_vec3(scene->data.sun.direction),
-        (v3s){ .raw = {0.0f, 1.0f, 0.0f}}
-    );
-    
-    // NOTE: invert the Y direction on projection matrix so that we match gltf axis
-    m4s sun_projection = glms_ortho(-20.f, 20.f, -20.f, 20.f, 25.f, -25.f);
-    sun_projection.raw[1][1] *= -1;
-
-    m4s sun_viewproj = glms_mat4_mul(sun_projection, sun_view);
-    scene->data.sun_viewproj = sun_viewproj;
+    shadow_cascades_fit(scene, view, aspect_ratio);
 
     if (sun_pov) {
-        if (sun_pov_persp) sun_viewproj = glms_mat4_mul(project, sun_view);
+        m4s sun_viewproj = scene->data.cascade_viewprojs[0];
+        if (sun_pov_persp) {
+            sun_viewproj = glms_mat4_mul(project, sun_view_matrix(scene));
+        }
         scene->data.viewproj = sun_viewproj;
     }
 
-    // Update light information
-    v4s l_pos = glms_vec4(scene->cam.position, 1.0f);
+    extract_frustum_planes(scene->data.viewproj, scene->data.frustum_planes);
+
+    // Update light information, the range in w is kept
     if (light_dynamic) {
-        scene->data.light.position = l_pos;
-        scene->data.light.position.y += light_offset;
+        point_light* camera_light = &scene->lights[0];
+        camera_light->position = glms_vec4(scene->cam.position, camera_light->position.w);
+        camera_light->position.y += light_offset;
     }
 }
 
@@ -248,12 +815,14 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         draw_image_usages,
         VK_IMAGE_ASPECT_COLOR_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_RENDER_TARGET,
         &scene->render_image);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_IMAGE, scene->render_image.handle, "MainRenderImage");
 
     // Depth attachment
     VkImageUsageFlags depth_image_usages = {0};
     depth_image_usages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depth_image_usages |= VK_IMAGE_USAGE_SAMPLED_BIT;
 
     image2D_create(state, 
         scene->render_extent,
@@ -261,6 +830,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         depth_image_usages,
         VK_IMAGE_ASPECT_DEPTH_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_RENDER_TARGET,
         &scene->depth_image);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_IMAGE, scene->depth_image.handle, "MainDepthImage");
 
@@ -310,41 +880,112 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         SET_DEBUG_NAME(state, VK_OBJECT_TYPE_COMMAND_BUFFER, scene->graphics_command_buffers[i], cmd_buff_name);
     }
 
+    VkQueryPoolCreateInfo timestamp_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = SCENE_TIMESTAMP_COUNT * state->swapchain.image_count,
+    };
+    VK_CHECK(vkCreateQueryPool(
+        state->device.handle,
+        &timestamp_pool_info,
+        state->allocator,
+        &scene->timestamp_pool));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_QUERY_POOL, scene->timestamp_pool, "TimestampQueryPool");
+    scene->frames_submitted = 0;
+    scene->geometry_pass_ms = 0.0f;
+    scene->depth_prepass = config.depth_prepass;
+
+    // NOTE: Every upload for the scene is recorded into one staging batch and waited on once.
+    // Failures jump to the end of the batch, so it is closed on every path
+    b8 result = false;
+    staging_batch_begin(state);
+
     // Buffers
+    // NOTE: One slice of scene_data per frame in flight, written from the host in scene_render
+    u64 uniform_alignment = state->device.gpu_limits.minUniformBufferOffsetAlignment;
+    scene->scene_uniforms_stride = (sizeof(scene_data) + uniform_alignment - 1) & ~(uniform_alignment - 1);
     buffer_create(
         state,
-        sizeof(scene_data),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        scene->scene_uniforms_stride * state->swapchain.image_count,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_SCENE,
         &scene->scene_uniforms);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->scene_uniforms.handle, "FrameUniformsBuffer");
     buffer_create(
         state,
-        sizeof(u32) * (scene->mat_pipe_count + /* Shadow map draw commands */ 1),
+        sizeof(u32) * (DRAW_INDEX_TYPE_COUNT * (scene->mat_pipe_count + /* Shadow map draw commands */ MAX_SHADOW_CASCADES) + /* Culling stats */ CULL_STAT_COUNT * state->swapchain.image_count),
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
         &scene->counts_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->counts_buffer.handle, "PipelineDrawCountsBuffer");
+    // Culling stats are accumulated across the frame & reset from the host
+    etzero_memory(scene->counts_buffer.alloc.mapped, scene->counts_buffer.size);
     buffer_create(
         state,
         sizeof(VkDeviceAddress) * (scene->mat_pipe_count + /* Shadow map draw commands */ 1),
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
         &scene->draws_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->draws_buffer.handle, "PipelineDrawBufferPointersBuffer");
 
-    u64 vertex_count = dynarray_length(scene->vertices);
+    // NOTE: Never empty so both index buffers exist, whichever index type the geometries use
+    u32 zero_index = 0;
+    u16 zero_index_u16 = 0;
+    if (dynarray_is_empty(scene->indices)) {
+        dynarray_push((void**)&scene->indices, &zero_index);
+    }
+    if (dynarray_is_empty(scene->indices_u16)) {
+        dynarray_push((void**)&scene->indices_u16, &zero_index_u16);
+    }
+    u64 vertex_count = dynarray_length(scene->positions);
     u64 index_count = dynarray_length(scene->indices);
     mesh_buffers vertex_index = upload_mesh_immediate(
         state,
         index_count,
         scene->indices,
         vertex_count,
-        scene->vertices);
-    scene->vertex_buffer = vertex_index.vertex_buffer;
+        scene->positions);
+    scene->position_buffer = vertex_index.vertex_buffer;
     scene->index_buffer = vertex_index.index_buffer;
-    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->vertex_buffer.handle, "VertexBuffer");
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->position_buffer.handle, "PositionBuffer");
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->index_buffer.handle, "IndexBuffer");
+    buffer_create_data(
+        state,
+        scene->indices_u16,
+        sizeof(u16) * dynarray_length(scene->indices_u16),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
+        &scene->index_buffer_u16);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->index_buffer_u16.handle, "IndexBufferU16");
+    buffer_create_data(
+        state,
+        scene->attributes,
+        sizeof(packed_attributes) * dynarray_length(scene->attributes),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
+        &scene->attribute_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->attribute_buffer.handle, "VertexAttributeBuffer");
+
+    // NOTE: Never empty so the color binding always has a buffer, even with no vertex colors
+    u32 white = 0xFFFFFFFF;
+    if (dynarray_is_empty(scene->colors)) {
+        dynarray_push((void**)&scene->colors, &white);
+    }
+    buffer_create_data(
+        state,
+        scene->colors,
+        sizeof(u32) * dynarray_length(scene->colors),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
+        &scene->color_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->color_buffer.handle, "VertexColorBuffer");
 
     buffer_create_data(
         state,
@@ -352,15 +993,17 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         sizeof(object) * dynarray_length(scene->objects),
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_SCENE,
         &scene->object_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->object_buffer.handle, "ObjectBuffer");
 
     buffer_create_data(
         state,
         scene->transforms,
-        sizeof(m4s) * dynarray_length(scene->transforms),
+        sizeof(affine_transform) * dynarray_length(scene->transforms),
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_SCENE,
         &scene->transform_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->transform_buffer.handle, "TransformBuffer");
     
@@ -370,9 +1013,141 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         sizeof(geometry) * dynarray_length(scene->geometries),
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
         &scene->geometry_buffer);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->geometry_buffer.handle, "GeometryBuffer");
 
+    // Written by the early draw generation pass before it is read, so it is left uninitialized
+    buffer_create(
+        state,
+        sizeof(u32) * dynarray_length(scene->objects),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
+        &scene->occlusion_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->occlusion_buffer.handle, "OcclusionFlagsBuffer");
+
+    buffer_create_data(
+        state,
+        scene->meshlets,
+        sizeof(meshlet) * dynarray_length(scene->meshlets),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_GEOMETRY,
+        &scene->meshlet_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->meshlet_buffer.handle, "MeshletBuffer");
+
+    pipe_range* pipe_ranges = etallocate(sizeof(pipe_range) * scene->mat_pipe_count, MEMORY_TAG_SCENE);
+    scene->instance_level_count = pipe_ranges_build(scene->objects, scene->instance_groups, scene->geometries, pipe_ranges, scene->mat_pipe_count);
+    buffer_create_data(
+        state,
+        pipe_ranges,
+        sizeof(pipe_range) * scene->mat_pipe_count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
+        &scene->pipe_range_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->pipe_range_buffer.handle, "PipeRangeBuffer");
+    etfree(pipe_ranges, sizeof(pipe_range) * scene->mat_pipe_count, MEMORY_TAG_SCENE);
+
+    // NOTE: Never empty so the binding always has a buffer, the count in scene_data stays 0
+    scene->data.instance_group_count = dynarray_length(scene->instance_groups);
+    if (dynarray_is_empty(scene->instance_groups)) {
+        instance_group empty_group = {0};
+        dynarray_push((void**)&scene->instance_groups, &empty_group);
+    }
+    buffer_create_data(
+        state,
+        scene->instance_groups,
+        sizeof(instance_group) * dynarray_length(scene->instance_groups),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
+        &scene->instance_group_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->instance_group_buffer.handle, "InstanceGroupBuffer");
+
+    // Single instance draws read the object's own transform at first_instance = object index, the
+    // visible instance lists of every group & level of detail follow & are written by draw generation.
+    // A group's lists share the range of its objects, as each visible instance is in one of them
+    u32 instance_object_count = dynarray_length(scene->objects);
+    u64 instance_buffer_size = sizeof(u32) * (instance_object_count * 2 + /* Never empty */ 1);
+    u32* instances = etallocate(instance_buffer_size, MEMORY_TAG_SCENE);
+    etzero_memory(instances, instance_buffer_size);
+    for (u32 i = 0; i < instance_object_count; ++i) {
+        instances[i] = scene->objects[i].transform_id;
+    }
+    buffer_create_data(
+        state,
+        instances,
+        instance_buffer_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
+        &scene->instance_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->instance_buffer.handle, "InstanceBuffer");
+    etfree(instances, instance_buffer_size, MEMORY_TAG_SCENE);
+
+    // Every object passing object culling at its largest level of detail bounds the number of clusters in one pass
+    scene->cluster_capacity = 0;
+    u32 object_count = dynarray_length(scene->objects);
+    for (u32 i = 0; i < object_count; ++i) {
+        // Instanced objects are drawn per level of detail, not through the cluster list
+        if (scene->objects[i].group_id != INVALID_ID) {
+            continue;
+        }
+        geometry* geo = &scene->geometries[scene->objects[i].geo_id];
+        u32 meshlet_count = 0;
+        for (u32 j = 0; j < geo->lod_count; ++j) {
+            if (geo->lods[j].meshlet_count > meshlet_count) {
+                meshlet_count = geo->lods[j].meshlet_count;
+            }
+        }
+        scene->cluster_capacity += meshlet_count;
+    }
+    buffer_create(
+        state,
+        sizeof(u32) * /* Dispatch header */ 4 + sizeof(u32) * 2 * scene->cluster_capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
+        &scene->cluster_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->cluster_buffer.handle, "ClusterBuffer");
+
+    // Object, cluster & instance level regions with a trailing total each, followed by their block totals. See scan.glsl
+    u32 scan_element_count =
+        OBJECT_SCAN_REGION_COUNT * ((object_count + 1) + scan_block_count(object_count + 1)) +
+        (scene->cluster_capacity + 1) + scan_block_count(scene->cluster_capacity + 1) +
+        (scene->instance_level_count + 1) + scan_block_count(scene->instance_level_count + 1);
+    buffer_create(
+        state,
+        sizeof(u32) * 2 * scan_element_count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
+        &scene->scan_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->scan_buffer.handle, "ScanBuffer");
+
+    // NOTE: Lights are dynamic, so like scene_data there is a slice per frame in flight written in scene_render
+    u64 storage_alignment = state->device.gpu_limits.minStorageBufferOffsetAlignment;
+    u64 light_slice_size = sizeof(point_light) * dynarray_length(scene->lights);
+    scene->light_buffer_stride = (light_slice_size + storage_alignment - 1) & ~(storage_alignment - 1);
+    buffer_create(
+        state,
+        scene->light_buffer_stride * state->swapchain.image_count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_SCENE,
+        &scene->light_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->light_buffer.handle, "LightBuffer");
+    buffer_create(
+        state,
+        sizeof(u32) * LIGHT_CLUSTER_COUNT * (/* Light count */ 1 + LIGHT_CLUSTER_MAX_LIGHTS),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_SCENE,
+        &scene->light_cluster_buffer);
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_BUFFER, scene->light_cluster_buffer.handle, "LightClusterBuffer");
+
     // NOTE: Descriptors init function placed here for testing payload with x amount of mat_pipe_configs
     // Set 0: Scene set layout (engine specific). The set itself will be allocated on the fly
     VkDescriptorBindingFlags ssbf = 
@@ -385,8 +1160,19 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         [SCENE_SET_DRAW_BUFFERS_BINDING] = ssbf,
         [SCENE_SET_OBJECTS_BINDING] = ssbf,
         [SCENE_SET_GEOMETRIES_BINDING] = ssbf,
-        [SCENE_SET_VERTICES_BINDING] = ssbf,
+        [SCENE_SET_POSITIONS_BINDING] = ssbf,
         [SCENE_SET_TRANSFORMS_BINDING] = ssbf,
+        [SCENE_SET_OCCLUSION_BINDING] = ssbf,
+        [SCENE_SET_MESHLETS_BINDING] = ssbf,
+        [SCENE_SET_CLUSTERS_BINDING] = ssbf,
+        [SCENE_SET_COLORS_BINDING] = ssbf,
+        [SCENE_SET_ATTRIBUTES_BINDING] = ssbf,
+        [SCENE_SET_INSTANCE_GROUPS_BINDING] = ssbf,
+        [SCENE_SET_INSTANCES_BINDING] = ssbf,
+        [SCENE_SET_PIPE_RANGES_BINDING] = ssbf,
+        [SCENE_SET_SCAN_BINDING] = ssbf,
+        [SCENE_SET_LIGHTS_BINDING] = ssbf,
+        [SCENE_SET_LIGHT_CLUSTERS_BINDING] = ssbf,
         [SCENE_SET_TEXTURES_BINDING] = ssbf | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,
     };
     VkDescriptorSetLayoutBindingFlagsCreateInfo scene_binding_flags_create_info = {
@@ -431,8 +1217,8 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
             .pImmutableSamplers = NULL,
         },
-        [SCENE_SET_VERTICES_BINDING] = {
-            .binding = SCENE_SET_VERTICES_BINDING,
+        [SCENE_SET_POSITIONS_BINDING] = {
+            .binding = SCENE_SET_POSITIONS_BINDING,
             .descriptorCount = 1,
             .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
@@ -445,11 +1231,88 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
             .pImmutableSamplers = NULL,
         },
+        [SCENE_SET_OCCLUSION_BINDING] = {
+            .binding = SCENE_SET_OCCLUSION_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_MESHLETS_BINDING] = {
+            .binding = SCENE_SET_MESHLETS_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_CLUSTERS_BINDING] = {
+            .binding = SCENE_SET_CLUSTERS_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_COLORS_BINDING] = {
+            .binding = SCENE_SET_COLORS_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_ATTRIBUTES_BINDING] = {
+            .binding = SCENE_SET_ATTRIBUTES_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_INSTANCE_GROUPS_BINDING] = {
+            .binding = SCENE_SET_INSTANCE_GROUPS_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_INSTANCES_BINDING] = {
+            .binding = SCENE_SET_INSTANCES_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_PIPE_RANGES_BINDING] = {
+            .binding = SCENE_SET_PIPE_RANGES_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_SCAN_BINDING] = {
+            .binding = SCENE_SET_SCAN_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_LIGHTS_BINDING] = {
+            .binding = SCENE_SET_LIGHTS_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
+        [SCENE_SET_LIGHT_CLUSTERS_BINDING] = {
+            .binding = SCENE_SET_LIGHT_CLUSTERS_BINDING,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL,
+        },
         [SCENE_SET_TEXTURES_BINDING] = {
             .binding = SCENE_SET_TEXTURES_BINDING,
             .descriptorCount = state->device.properties_12.maxDescriptorSetUpdateAfterBindSampledImages,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
             .pImmutableSamplers = NULL,
         },
     };
@@ -512,11 +1375,11 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
     VkDescriptorPoolSize sizes[] = {
         [0] = {
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = MAX_TEXTURE_COUNT,
+            .descriptorCount = MAX_TEXTURE_COUNT * state->swapchain.image_count,
         },
         [1] = {
             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-            .descriptorCount = 2 * scene->mat_pipe_count + SCENE_SET_BINDING_MAX,
+            .descriptorCount = 2 * scene->mat_pipe_count + SCENE_SET_BINDING_MAX * state->swapchain.image_count,
         },
         [2] = {
             .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -527,7 +1390,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = 0,
         .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
-        .maxSets = 1 + scene->mat_pipe_count,
+        .maxSets = state->swapchain.image_count + scene->mat_pipe_count,
         .poolSizeCount = 3,
         .pPoolSizes = sizes,
     };
@@ -538,30 +1401,40 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         &scene->descriptor_pool));
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_DESCRIPTOR_POOL, scene->descriptor_pool, "Scene Descriptor Pool");
 
-    u32 scene_texture_count = MAX_TEXTURE_COUNT;
-    VkDescriptorSetVariableDescriptorCountAllocateInfo scene_descriptor_count_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
-        .descriptorSetCount = 1,
-        .pDescriptorCounts = &scene_texture_count,
-    };
-    VkDescriptorSetAllocateInfo scene_set_alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .pNext = &scene_descriptor_count_info,
-        .descriptorPool = scene->descriptor_pool,
-        .descriptorSetCount = 1,
-        .pSetLayouts = &scene->scene_set_layout,
-    };
-    VK_CHECK(vkAllocateDescriptorSets(
-        state->device.handle,
-        &scene_set_alloc_info,
-        &scene->scene_set));
-    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_DESCRIPTOR_SET, scene->scene_set, "Scene Descriptor Set");
+    // NOTE: One scene set per frame in flight, each pointing at its frame's uniform slice.
+    // Dynamic uniform buffers are not allowed in update after bind layouts.
+    u32 frame_overlap = state->swapchain.image_count;
+    scene->scene_sets = etallocate(sizeof(VkDescriptorSet) * frame_overlap, MEMORY_TAG_SCENE);
+    for (u32 i = 0; i < frame_overlap; ++i) {
+        DEBUG_BLOCK(
+            char set_name[] = "Scene Descriptor Set X";
+            set_name[str_length(set_name) - 1] = '0' + i;
+        );
+        u32 scene_texture_count = MAX_TEXTURE_COUNT;
+        VkDescriptorSetVariableDescriptorCountAllocateInfo scene_descriptor_count_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+            .descriptorSetCount = 1,
+            .pDescriptorCounts = &scene_texture_count,
+        };
+        VkDescriptorSetAllocateInfo scene_set_alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = &scene_descriptor_count_info,
+            .descriptorPool = scene->descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &scene->scene_set_layout,
+        };
+        VK_CHECK(vkAllocateDescriptorSets(
+            state->device.handle,
+            &scene_set_alloc_info,
+            &scene->scene_sets[i]));
+        SET_DEBUG_NAME(state, VK_OBJECT_TYPE_DESCRIPTOR_SET, scene->scene_sets[i], set_name);
+    }
 
     // Write buffers to DescriptorSet
     VkDescriptorBufferInfo uniform_buffer_info = {
         .buffer = scene->scene_uniforms.handle,
         .offset = 0,
-        .range = VK_WHOLE_SIZE,
+        .range = sizeof(scene_data),
     };
     VkWriteDescriptorSet uniform_buffer_write = {
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -569,7 +1442,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .dstBinding = SCENE_SET_FRAME_UNIFORMS_BINDING,
         .pBufferInfo = &uniform_buffer_info,
     };
@@ -584,7 +1457,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .dstBinding = SCENE_SET_DRAW_COUNTS_BINDING,
         .pBufferInfo = &draw_count_buffer_info,
     };
@@ -599,7 +1472,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .dstBinding = SCENE_SET_DRAW_BUFFERS_BINDING,
         .pBufferInfo = &draws_buffer_info,
     };
@@ -614,7 +1487,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .dstBinding = SCENE_SET_OBJECTS_BINDING,
         .pBufferInfo = &object_buffer_info,
     };
@@ -629,24 +1502,24 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .dstBinding = SCENE_SET_GEOMETRIES_BINDING,
         .pBufferInfo = &geometry_buffer_info,
     };
-    VkDescriptorBufferInfo vertex_buffer_info = {
-        .buffer = scene->vertex_buffer.handle,
+    VkDescriptorBufferInfo position_buffer_info = {
+        .buffer = scene->position_buffer.handle,
         .offset = 0,
         .range = VK_WHOLE_SIZE,
     };
-    VkWriteDescriptorSet vertex_buffer_write = {
+    VkWriteDescriptorSet position_buffer_write = {
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .pNext = 0,
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .dstSet = scene->scene_set,
-        .dstBinding = SCENE_SET_VERTICES_BINDING,
-        .pBufferInfo = &vertex_buffer_info,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_POSITIONS_BINDING,
+        .pBufferInfo = &position_buffer_info,
     };
     VkDescriptorBufferInfo transform_buffer_info = {
         .buffer = scene->transform_buffer.handle,
@@ -659,35 +1532,219 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .dstBinding = SCENE_SET_TRANSFORMS_BINDING,
         .pBufferInfo = &transform_buffer_info,
     };
-    VkWriteDescriptorSet buffer_writes[] = {
-        uniform_buffer_write,
-        object_buffer_write,
-        draw_count_buffer_write,
-        draws_buffer_write,
-        geometry_buffer_write,
-        vertex_buffer_write,
-        transform_buffer_write,
+    VkDescriptorBufferInfo occlusion_buffer_info = {
+        .buffer = scene->occlusion_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
     };
-    vkUpdateDescriptorSets(
-        state->device.handle,
-        /* writeCount: */ 7,
-        buffer_writes,
-        /* copyCount: */ 0,
-        /* copies: */ 0
-    );
-    // NOTE: Descriptors init: END
-
-    // Images
-    image_manager_initialize(&scene->image_bank, state);
-    u32 image_count = dynarray_length(scene->payload.images);
-    image2D_config* image_configs = etallocate(sizeof(image2D_config) * image_count, MEMORY_TAG_SCENE);
-    for (u32 i = 0; i < image_count; ++i) {
-        import_image image = scene->payload.images[i];
-        image_configs[i] = (image2D_config) {
+    VkWriteDescriptorSet occlusion_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_OCCLUSION_BINDING,
+        .pBufferInfo = &occlusion_buffer_info,
+    };
+    VkDescriptorBufferInfo meshlet_buffer_info = {
+        .buffer = scene->meshlet_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet meshlet_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_MESHLETS_BINDING,
+        .pBufferInfo = &meshlet_buffer_info,
+    };
+    VkDescriptorBufferInfo cluster_buffer_info = {
+        .buffer = scene->cluster_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet cluster_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_CLUSTERS_BINDING,
+        .pBufferInfo = &cluster_buffer_info,
+    };
+    VkDescriptorBufferInfo color_buffer_info = {
+        .buffer = scene->color_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet color_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_COLORS_BINDING,
+        .pBufferInfo = &color_buffer_info,
+    };
+    VkDescriptorBufferInfo attribute_buffer_info = {
+        .buffer = scene->attribute_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet attribute_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_ATTRIBUTES_BINDING,
+        .pBufferInfo = &attribute_buffer_info,
+    };
+    VkDescriptorBufferInfo instance_group_buffer_info = {
+        .buffer = scene->instance_group_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet instance_group_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_INSTANCE_GROUPS_BINDING,
+        .pBufferInfo = &instance_group_buffer_info,
+    };
+    VkDescriptorBufferInfo instance_buffer_info = {
+        .buffer = scene->instance_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet instance_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_INSTANCES_BINDING,
+        .pBufferInfo = &instance_buffer_info,
+    };
+    VkDescriptorBufferInfo pipe_range_buffer_info = {
+        .buffer = scene->pipe_range_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet pipe_range_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_PIPE_RANGES_BINDING,
+        .pBufferInfo = &pipe_range_buffer_info,
+    };
+    VkDescriptorBufferInfo scan_buffer_info = {
+        .buffer = scene->scan_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet scan_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_SCAN_BINDING,
+        .pBufferInfo = &scan_buffer_info,
+    };
+    VkDescriptorBufferInfo light_buffer_info = {
+        .buffer = scene->light_buffer.handle,
+        .offset = 0,
+        .range = sizeof(point_light) * dynarray_length(scene->lights),
+    };
+    VkWriteDescriptorSet light_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_LIGHTS_BINDING,
+        .pBufferInfo = &light_buffer_info,
+    };
+    VkDescriptorBufferInfo light_cluster_buffer_info = {
+        .buffer = scene->light_cluster_buffer.handle,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    VkWriteDescriptorSet light_cluster_buffer_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .dstSet = scene->scene_sets[0],
+        .dstBinding = SCENE_SET_LIGHT_CLUSTERS_BINDING,
+        .pBufferInfo = &light_cluster_buffer_info,
+    };
+    VkWriteDescriptorSet buffer_writes[] = {
+        uniform_buffer_write,
+        object_buffer_write,
+        draw_count_buffer_write,
+        draws_buffer_write,
+        geometry_buffer_write,
+        position_buffer_write,
+        transform_buffer_write,
+        occlusion_buffer_write,
+        meshlet_buffer_write,
+        cluster_buffer_write,
+        color_buffer_write,
+        attribute_buffer_write,
+        instance_group_buffer_write,
+        instance_buffer_write,
+        pipe_range_buffer_write,
+        scan_buffer_write,
+        light_buffer_write,
+        light_cluster_buffer_write,
+    };
+    u32 buffer_write_count = sizeof(buffer_writes) / sizeof(VkWriteDescriptorSet);
+    for (u32 i = 0; i < frame_overlap; ++i) {
+        uniform_buffer_info.offset = scene->scene_uniforms_stride * i;
+        light_buffer_info.offset = scene->light_buffer_stride * i;
+        for (u32 j = 0; j < buffer_write_count; ++j) {
+            buffer_writes[j].dstSet = scene->scene_sets[i];
+        }
+        vkUpdateDescriptorSets(
+            state->device.handle,
+            buffer_write_count,
+            buffer_writes,
+            /* copyCount: */ 0,
+            /* copies: */ 0
+        );
+    }
+    // NOTE: Descriptors init: END
+
+    // Images
+    image_manager_initialize(&scene->image_bank, state);
+    u32 image_count = dynarray_length(scene->payload.images);
+    image2D_config* image_configs = etallocate(sizeof(image2D_config) * image_count, MEMORY_TAG_SCENE);
+    for (u32 i = 0; i < image_count; ++i) {
+        import_image image = scene->payload.images[i];
+        image_configs[i] = (image2D_config) {
             .name = image.name,
             .width = image.width,
             .height = image.height,
@@ -719,18 +1776,20 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         ));
     }
 
-    // HACK:TEMP: More robust shadow mapping code
+    // Layer per cascade, all rendered in one layered pass
     VkExtent3D shadow_map_resolution = {
-        .width = 2048,
-        .height = 2048,
+        .width = SHADOW_CASCADE_RESOLUTION,
+        .height = SHADOW_CASCADE_RESOLUTION,
         .depth = 1};
-    image2D_create(
+    image2D_array_create(
         state,
         shadow_map_resolution,
+        scene->shadow_cascade_count,
         VK_FORMAT_D32_SFLOAT,
         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_IMAGE_ASPECT_DEPTH_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_RENDER_TARGET,
         &scene->shadow_map);
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_IMAGE, scene->shadow_map.handle, "ShadowMapImage");
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_IMAGE_VIEW, scene->shadow_map.view, "ShadowMapImageView");
@@ -752,8 +1811,25 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         state->allocator,
         &scene->shadow_map_sampler));
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_SAMPLER, scene->shadow_map_sampler, "ShadowMapSampler");
+    // NOTE: Reverse z, a receiver is lit when its depth is at least the depth in the map. The
+    // black border compares as lit
+    VkSamplerCreateInfo shadow_compare_sampler_info = shadow_map_sampler_info;
+    shadow_compare_sampler_info.compareEnable = VK_TRUE;
+    shadow_compare_sampler_info.compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    VK_CHECK(vkCreateSampler(
+        state->device.handle,
+        &shadow_compare_sampler_info,
+        state->allocator,
+        &scene->shadow_compare_sampler));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_SAMPLER, scene->shadow_compare_sampler, "ShadowCompareSampler");
     // HACK:TEMP: END
 
+    // NOTE: Built from the depth image every frame for occlusion culling
+    if (!depth_pyramid_create(state, &scene->depth_image, &scene->depth_pyramid)) {
+        ETFATAL("Unable to create depth pyramid.");
+        goto batch_end;
+    }
+
     // Texture defaults using default samplers and images from renderer_state
     VkDescriptorImageInfo white_texture_info = {
         .sampler = state->linear_smpl,
@@ -766,7 +1842,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = RESERVED_TEXTURE_WHITE_INDEX,
         .dstBinding = SCENE_SET_TEXTURES_BINDING,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .pImageInfo = &white_texture_info,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
     };
@@ -781,7 +1857,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = RESERVED_TEXTURE_BLACK_INDEX,
         .dstBinding = SCENE_SET_TEXTURES_BINDING,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .pImageInfo = &black_texture_info,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
     };
@@ -796,14 +1872,14 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = RESERVED_TEXTURE_NORMAL_INDEX,
         .dstBinding = SCENE_SET_TEXTURES_BINDING,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .pImageInfo = &normal_texture_info,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
     };
     VkDescriptorImageInfo shadow_map_texture_info = {
         .sampler = scene->shadow_map_sampler,
         .imageView = scene->shadow_map.view,
-        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
     };
     VkWriteDescriptorSet shadow_map_texture_write = {
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -811,23 +1887,60 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .descriptorCount = 1,
         .dstArrayElement = RESERVED_TEXTURE_SHADOW_MAP_INDEX,
         .dstBinding = SCENE_SET_TEXTURES_BINDING,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .pImageInfo = &shadow_map_texture_info,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
     };
+    VkDescriptorImageInfo depth_pyramid_texture_info = {
+        .sampler = scene->depth_pyramid.reduction_sampler,
+        .imageView = scene->depth_pyramid.image.view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkWriteDescriptorSet depth_pyramid_texture_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = RESERVED_TEXTURE_DEPTH_PYRAMID_INDEX,
+        .dstBinding = SCENE_SET_TEXTURES_BINDING,
+        .dstSet = scene->scene_sets[0],
+        .pImageInfo = &depth_pyramid_texture_info,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    };
+    VkDescriptorImageInfo shadow_compare_texture_info = {
+        .sampler = scene->shadow_compare_sampler,
+        .imageView = scene->shadow_map.view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet shadow_compare_texture_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = 0,
+        .descriptorCount = 1,
+        .dstArrayElement = RESERVED_TEXTURE_SHADOW_COMPARE_INDEX,
+        .dstBinding = SCENE_SET_TEXTURES_BINDING,
+        .dstSet = scene->scene_sets[0],
+        .pImageInfo = &shadow_compare_texture_info,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    };
     VkWriteDescriptorSet reserved_texture_writes[RESERVED_TEXTURE_INDEX_COUNT] = {
         white_texture_write,
         black_texture_write,
         normal_texture_write,
         shadow_map_texture_write,
+        depth_pyramid_texture_write,
+        shadow_compare_texture_write,
     };
-    vkUpdateDescriptorSets(
-        state->device.handle,
-        RESERVED_TEXTURE_INDEX_COUNT,
-        reserved_texture_writes,
-        /* copy count */ 0,
-        /* copies */ NULL
-    );
+    for (u32 i = 0; i < frame_overlap; ++i) {
+        for (u32 j = 0; j < RESERVED_TEXTURE_INDEX_COUNT; ++j) {
+            reserved_texture_writes[j].dstSet = scene->scene_sets[i];
+        }
+        vkUpdateDescriptorSets(
+            state->device.handle,
+            RESERVED_TEXTURE_INDEX_COUNT,
+            reserved_texture_writes,
+            /* copy count */ 0,
+            /* copies */ NULL
+        );
+    }
 
     // Textures
     u32 texture_count = dynarray_length(scene->payload.textures);
@@ -839,13 +1952,29 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
     shader draw_gen;
     if (!load_shader(state, draw_gen_path, &draw_gen)) {
         ETFATAL("Unable to load draw generation shader.");
-        return false;
+        goto batch_end;
     }
+    // NOTE: The shadow pipeline shares this layout, so it carries the draw offset push constant
+    VkPushConstantRange draw_push_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(draw_push),
+    };
+    VkPushConstantRange draw_gen_push_ranges[] = {
+        draw_push_range,
+        {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(scan_push),
+        },
+    };
     VkPipelineLayoutCreateInfo draw_gen_layout_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = 0,
         .setLayoutCount = 1,
-        .pSetLayouts = &scene->scene_set_layout};
+        .pSetLayouts = &scene->scene_set_layout,
+        .pushConstantRangeCount = sizeof(draw_gen_push_ranges) / sizeof(VkPushConstantRange),
+        .pPushConstantRanges = draw_gen_push_ranges};
     VK_CHECK(vkCreatePipelineLayout(
         state->device.handle,
         &draw_gen_layout_info,
@@ -871,8 +2000,275 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         state->allocator,
         &scene->draw_gen_pipeline));
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->draw_gen_pipeline, "DrawGenerationPipeline");
+
+    // Late occlusion pass, same shader with the LATE specialization constant set
+    VkBool32 late = VK_TRUE;
+    VkSpecializationMapEntry late_entry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(VkBool32),
+    };
+    VkSpecializationInfo late_specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &late_entry,
+        .dataSize = sizeof(VkBool32),
+        .pData = &late,
+    };
+    draw_pipeline_info.stage.pSpecializationInfo = &late_specialization;
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &draw_pipeline_info,
+        state->allocator,
+        &scene->late_draw_gen_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->late_draw_gen_pipeline, "LateDrawGenerationPipeline");
     unload_shader(state, &draw_gen);
 
+    shader cluster_cull;
+    if (!load_shader(state, "assets/shaders/cluster_cull.comp.spv.opt", &cluster_cull)) {
+        ETFATAL("Unable to load cluster culling shader.");
+        goto batch_end;
+    }
+    VkComputePipelineCreateInfo cluster_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = cluster_cull.entry_point,
+            .stage = cluster_cull.stage,
+            .module = cluster_cull.module,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &cluster_pipeline_info,
+        state->allocator,
+        &scene->cluster_cull_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->cluster_cull_pipeline, "ClusterCullingPipeline");
+    unload_shader(state, &cluster_cull);
+
+    shader instance_draws;
+    if (!load_shader(state, "assets/shaders/instance_draws.comp.spv.opt", &instance_draws)) {
+        ETFATAL("Unable to load instance draw generation shader.");
+        goto batch_end;
+    }
+    // Level & draw phases of the same shader, selected by the PHASE specialization constant
+    u32 instance_phase = /* INSTANCE_PHASE_LEVELS */ 0;
+    VkSpecializationMapEntry instance_phase_entry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(u32),
+    };
+    VkSpecializationInfo instance_specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &instance_phase_entry,
+        .dataSize = sizeof(u32),
+        .pData = &instance_phase,
+    };
+    VkComputePipelineCreateInfo instance_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = instance_draws.entry_point,
+            .stage = instance_draws.stage,
+            .module = instance_draws.module,
+            .pSpecializationInfo = &instance_specialization,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &instance_pipeline_info,
+        state->allocator,
+        &scene->instance_level_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->instance_level_pipeline, "InstanceLevelPipeline");
+    instance_phase = /* INSTANCE_PHASE_DRAWS */ 1;
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &instance_pipeline_info,
+        state->allocator,
+        &scene->instance_draw_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->instance_draw_pipeline, "InstanceDrawGenerationPipeline");
+    unload_shader(state, &instance_draws);
+
+    shader prefix_sum;
+    if (!load_shader(state, "assets/shaders/prefix_sum.comp.spv.opt", &prefix_sum)) {
+        ETFATAL("Unable to load prefix sum shader.");
+        goto batch_end;
+    }
+    // Block, block total & block pair phases of the same shader, selected by the PHASE specialization constant
+    u32 scan_phase = /* SCAN_PHASE_BLOCK */ 0;
+    VkSpecializationMapEntry scan_phase_entry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(u32),
+    };
+    VkSpecializationInfo scan_specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &scan_phase_entry,
+        .dataSize = sizeof(u32),
+        .pData = &scan_phase,
+    };
+    VkComputePipelineCreateInfo scan_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = prefix_sum.entry_point,
+            .stage = prefix_sum.stage,
+            .module = prefix_sum.module,
+            .pSpecializationInfo = &scan_specialization,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &scan_pipeline_info,
+        state->allocator,
+        &scene->scan_block_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->scan_block_pipeline, "ScanBlockPipeline");
+    scan_phase = /* SCAN_PHASE_SUMS */ 1;
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &scan_pipeline_info,
+        state->allocator,
+        &scene->scan_sums_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->scan_sums_pipeline, "ScanSumsPipeline");
+    scan_phase = /* SCAN_PHASE_BLOCK_PAIR */ 2;
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &scan_pipeline_info,
+        state->allocator,
+        &scene->scan_pair_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->scan_pair_pipeline, "ScanPairPipeline");
+    unload_shader(state, &prefix_sum);
+
+    shader cluster_scatter;
+    if (!load_shader(state, "assets/shaders/cluster_scatter.comp.spv.opt", &cluster_scatter)) {
+        ETFATAL("Unable to load cluster scatter shader.");
+        goto batch_end;
+    }
+    VkComputePipelineCreateInfo cluster_scatter_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = cluster_scatter.entry_point,
+            .stage = cluster_scatter.stage,
+            .module = cluster_scatter.module,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &cluster_scatter_pipeline_info,
+        state->allocator,
+        &scene->cluster_scatter_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->cluster_scatter_pipeline, "ClusterScatterPipeline");
+    unload_shader(state, &cluster_scatter);
+
+    shader shadow_scatter;
+    if (!load_shader(state, "assets/shaders/shadow_scatter.comp.spv.opt", &shadow_scatter)) {
+        ETFATAL("Unable to load shadow scatter shader.");
+        goto batch_end;
+    }
+    VkComputePipelineCreateInfo shadow_scatter_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = shadow_scatter.entry_point,
+            .stage = shadow_scatter.stage,
+            .module = shadow_scatter.module,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &shadow_scatter_pipeline_info,
+        state->allocator,
+        &scene->shadow_scatter_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->shadow_scatter_pipeline, "ShadowScatterPipeline");
+    unload_shader(state, &shadow_scatter);
+
+    shader draw_scatter;
+    if (!load_shader(state, "assets/shaders/draw_scatter.comp.spv.opt", &draw_scatter)) {
+        ETFATAL("Unable to load draw scatter shader.");
+        goto batch_end;
+    }
+    VkComputePipelineCreateInfo draw_scatter_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = draw_scatter.entry_point,
+            .stage = draw_scatter.stage,
+            .module = draw_scatter.module,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &draw_scatter_pipeline_info,
+        state->allocator,
+        &scene->draw_scatter_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->draw_scatter_pipeline, "DrawScatterPipeline");
+    unload_shader(state, &draw_scatter);
+
+    shader light_cull;
+    if (!load_shader(state, "assets/shaders/light_cull.comp.spv.opt", &light_cull)) {
+        ETFATAL("Unable to load light culling shader.");
+        goto batch_end;
+    }
+    VkComputePipelineCreateInfo light_cull_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .layout = scene->draw_gen_layout,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .pName = light_cull.entry_point,
+            .stage = light_cull.stage,
+            .module = light_cull.module,
+        },
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        state->device.handle,
+        VK_NULL_HANDLE,
+        /* CreateInfoCount */ 1,
+        &light_cull_pipeline_info,
+        state->allocator,
+        &scene->light_cull_pipeline));
+    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->light_cull_pipeline, "LightCullPipeline");
+    unload_shader(state, &light_cull);
+
     // Create Pipeline for bindless shaders
     VkDescriptorSetLayout pipeline_ds_layouts[] = {
         [0] = scene->scene_set_layout,
@@ -883,6 +2279,8 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
         .pNext = 0,
         .setLayoutCount = 2,
         .pSetLayouts = pipeline_ds_layouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &draw_push_range,
     };
     VK_CHECK(vkCreatePipelineLayout(
         state->device.handle,
@@ -892,14 +2290,7 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
     SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE_LAYOUT, scene->mat_pipeline_layout, "SharedMaterialPipelineLayout");
 
     // Initialize materials and material pipelines
-    void* draw_buffer_addresses;
-    VK_CHECK(vkMapMemory(
-        state->device.handle,
-        scene->draws_buffer.memory,
-        /* offset */ 0,
-        VK_WHOLE_SIZE,
-        /* flags */ 0,
-        &draw_buffer_addresses));
+    void* draw_buffer_addresses = scene->draws_buffer.alloc.mapped;
     scene->mat_pipes = etallocate(sizeof(mat_pipe) * scene->mat_pipe_count, MEMORY_TAG_SCENE);
     for (u32 i = 0; i < scene->mat_pipe_count; ++i) {
         if (!mat_pipe_init(&scene->mat_pipes[i], scene, state, &scene->mat_pipe_configs[i])) {
@@ -908,60 +2299,48 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
                 scene->mat_pipe_configs[i].vert_path,
                 scene->mat_pipe_configs[i].frag_path
             );
-            return false;
+            goto batch_end;
         }
         VkDeviceAddress mat_draws_addr = buffer_get_address(state, &scene->mat_pipes[i].draws_buffer);
         etcopy_memory((VkDeviceAddress*)draw_buffer_addresses + i, &mat_draws_addr, sizeof(VkDeviceAddress));
     }
 
     // TEMP: Quick and dirty placement of this data
-    scene->data.max_draw_count = MAX_DRAW_COMMANDS * scene->mat_pipe_count;
+    scene->data.max_draw_count = MAX_DRAW_COMMANDS;
+    scene->data.render_height = (f32)scene->render_extent.height;
+    scene->data.render_width = (f32)scene->render_extent.width;
+    scene->data.z_near = CAMERA_Z_NEAR;
+    scene->data.z_far = CAMERA_Z_FAR;
+    scene->data.light_count = dynarray_length(scene->lights);
+    scene->data.lod_threshold = LOD_ERROR_THRESHOLD_PIXELS;
+    scene->data.object_count = dynarray_length(scene->objects);
+    scene->data.pipe_count = scene->mat_pipe_count;
+    scene->data.cluster_capacity = scene->cluster_capacity;
+    scene->data.instance_level_count = scene->instance_level_count;
     scene->data.alpha_cutoff = 0.5f;
     scene->data.shadow_draw_id = scene->mat_pipe_count;
     scene->data.shadow_map_id = RESERVED_TEXTURE_SHADOW_MAP_INDEX;
+    scene->data.shadow_compare_id = RESERVED_TEXTURE_SHADOW_COMPARE_INDEX;
+    scene->data.depth_pyramid_id = RESERVED_TEXTURE_DEPTH_PYRAMID_INDEX;
+    scene->data.occlusion_enabled = 0;
     // TEMP: END
 
     // NOTE: Shadow mapping start
     buffer_create(
         state,
-        sizeof(draw_command) * MAX_DRAW_COMMANDS,
+        sizeof(draw_command) * MAX_DRAW_COMMANDS * DRAW_INDEX_TYPE_COUNT * MAX_SHADOW_CASCADES,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        GPU_MEMORY_TAG_DRAWS,
         &scene->shadow_draws);
     scene->data.shadow_draw_id = scene->mat_pipe_count;
     VkDeviceAddress shadow_draws_addr = buffer_get_address(state, &scene->shadow_draws);
     etcopy_memory((VkDeviceAddress*)draw_buffer_addresses + scene->mat_pipe_count, &shadow_draws_addr, sizeof(VkDeviceAddress));
-    vkUnmapMemory(state->device.handle, scene->draws_buffer.memory);
-
-    shader shadow_draw_gen;
-    if (!load_shader(state, "assets/shaders/shadow_draws.comp.spv.opt", &shadow_draw_gen)) {
-        return false;
-    }
-    VkPipelineShaderStageCreateInfo shadow_draw_stage_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .pNext = 0,
-        .pName = shadow_draw_gen.entry_point,
-        .stage = shadow_draw_gen.stage,
-        .module = shadow_draw_gen.module};
-    VkComputePipelineCreateInfo shadow_draw_pipeline_info = {
-        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .pNext = 0,
-        .layout = scene->draw_gen_layout,
-        .stage = shadow_draw_stage_info};
-    VK_CHECK(vkCreateComputePipelines(
-        state->device.handle,
-        VK_NULL_HANDLE,
-        /* CreateInfoCount */ 1,
-        &shadow_draw_pipeline_info,
-        state->allocator,
-        &scene->shadow_draw_gen_pipeline));
-    SET_DEBUG_NAME(state, VK_OBJECT_TYPE_PIPELINE, scene->shadow_draw_gen_pipeline, "ShadowDrawGenerationPipeline");
-    unload_shader(state, &shadow_draw_gen);
 
     // TODO: Alpha passthrough for alpha-mask
     shader shadow_map_vert;
     if (!load_shader(state, "assets/shaders/shadow.vert.spv.opt", &shadow_map_vert)) {
-        return false;
+        goto batch_end;
     };
 
     pipeline_builder builder = pipeline_builder_create();
@@ -983,7 +2362,15 @@ b8 scene_renderer_init(scene* scene, scene_config config) {
 
     unload_shader(state, &shadow_map_vert);
     // NOTE: Shadow Mapping end
-    return true;
+    result = true;
+
+batch_end:
+    staging_batch_end(state);
+
+    if (result) {
+        gpu_memory_print_metrics(state);
+    }
+    return result;
 }
 
 void scene_renderer_shutdown(scene* scene, renderer_state* state) {
@@ -991,15 +2378,38 @@ void scene_renderer_shutdown(scene* scene, renderer_state* state) {
     vkDeviceWaitIdle(state->device.handle);
 
     buffer_destroy(state, &scene->index_buffer);
+    buffer_destroy(state, &scene->index_buffer_u16);
     buffer_destroy(state, &scene->scene_uniforms);
     buffer_destroy(state, &scene->counts_buffer);
     buffer_destroy(state, &scene->draws_buffer);
     buffer_destroy(state, &scene->object_buffer);
     buffer_destroy(state, &scene->geometry_buffer);
-    buffer_destroy(state, &scene->vertex_buffer);
+    buffer_destroy(state, &scene->position_buffer);
+    buffer_destroy(state, &scene->attribute_buffer);
     buffer_destroy(state, &scene->transform_buffer);
+    buffer_destroy(state, &scene->occlusion_buffer);
+    buffer_destroy(state, &scene->meshlet_buffer);
+    buffer_destroy(state, &scene->instance_group_buffer);
+    buffer_destroy(state, &scene->instance_buffer);
+    buffer_destroy(state, &scene->color_buffer);
+    buffer_destroy(state, &scene->cluster_buffer);
+    buffer_destroy(state, &scene->pipe_range_buffer);
+    buffer_destroy(state, &scene->scan_buffer);
+    buffer_destroy(state, &scene->light_buffer);
+    buffer_destroy(state, &scene->light_cluster_buffer);
 
     vkDestroyPipeline(state->device.handle, scene->draw_gen_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->late_draw_gen_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->cluster_cull_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->instance_level_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->instance_draw_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->scan_block_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->scan_sums_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->scan_pair_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->cluster_scatter_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->shadow_scatter_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->draw_scatter_pipeline, state->allocator);
+    vkDestroyPipeline(state->device.handle, scene->light_cull_pipeline, state->allocator);
     vkDestroyPipelineLayout(state->device.handle, scene->draw_gen_layout, state->allocator);
     vkDestroyPipelineLayout(state->device.handle, scene->mat_pipeline_layout, state->allocator);
 
@@ -1007,6 +2417,7 @@ void scene_renderer_shutdown(scene* scene, renderer_state* state) {
         state->device.handle,
         scene->descriptor_pool,
         state->allocator);
+    etfree(scene->scene_sets, sizeof(VkDescriptorSet) * state->swapchain.image_count, MEMORY_TAG_SCENE);
     vkDestroyDescriptorSetLayout(
         state->device.handle,
         scene->mat_set_layout,
@@ -1024,7 +2435,7 @@ void scene_renderer_shutdown(scene* scene, renderer_state* state) {
     buffer_destroy(state, &scene->shadow_draws);
     image_destroy(state, &scene->shadow_map);
     vkDestroySampler(state->device.handle, scene->shadow_map_sampler, state->allocator);
-    vkDestroyPipeline(state->device.handle, scene->shadow_draw_gen_pipeline, state->allocator);
+    vkDestroySampler(state->device.handle, scene->shadow_compare_sampler, state->allocator);
     vkDestroyPipeline(state->device.handle, scene->shadow_pipeline, state->allocator);
 
     for (u32 i = 0; i < scene->sampler_count; ++i)
@@ -1044,32 +2455,36 @@ void scene_renderer_shutdown(scene* scene, renderer_state* state) {
     etfree(scene->graphics_command_buffers, sizeof(VkCommandBuffer) * frame_overlap, MEMORY_TAG_SCENE);
     etfree(scene->graphics_pools, sizeof(VkCommandPool) * frame_overlap, MEMORY_TAG_SCENE);
     etfree(scene->render_fences, sizeof(VkFence) * frame_overlap, MEMORY_TAG_SCENE);
+    vkDestroyQueryPool(state->device.handle, scene->timestamp_pool, state->allocator);
 
+    depth_pyramid_destroy(state, &scene->depth_pyramid);
     image_destroy(state, &scene->depth_image);
     image_destroy(state, &scene->render_image);
 }
 
 // TODO: Data transfer commands to load information
 b8 scene_render(scene* scene, renderer_state* state) {
-    // TEMP:TODO: Create staging buffer to move this instead of vkCmdUpdateBuffer
+    // NOTE: The frame's render fence has been waited on, so its uniform slice is no longer read by the gpu.
+    // Host writes before vkQueueSubmit are visible to the submission without a barrier.
+    scene->data.cull_stats_id = DRAW_INDEX_TYPE_COUNT * (scene->mat_pipe_count + MAX_SHADOW_CASCADES) + CULL_STAT_COUNT * state->swapchain.frame_index;
+    // The early occlusion test uses the depth pyramid of the previous frame & the viewproj it was rendered with
+    scene->data.pyramid_viewproj = scene->pyramid_viewproj;
+    u8* frame_uniforms = (u8*)scene->scene_uniforms.alloc.mapped + scene->scene_uniforms_stride * state->swapchain.frame_index;
+    etcopy_memory(frame_uniforms, &scene->data, sizeof(scene_data));
+    u8* frame_lights = (u8*)scene->light_buffer.alloc.mapped + scene->light_buffer_stride * state->swapchain.frame_index;
+    etcopy_memory(frame_lights, scene->lights, sizeof(point_light) * scene->data.light_count);
+    scene->pyramid_viewproj = scene->data.viewproj;
+
+    // Zero the draw counts of the material & shadow draw buffers ahead of draw generation
     VkCommandBuffer cmd = scene->graphics_command_buffers[state->swapchain.frame_index];
-    vkCmdUpdateBuffer(cmd,
-        scene->scene_uniforms.handle,
-        /* Offset: */ 0,
-        sizeof(scene_data),
-        &scene->data);
     vkCmdFillBuffer(cmd,
         scene->counts_buffer.handle,
         /* Offset: */ 0,
-        sizeof(u32) * (scene->mat_pipe_count + /* shadow map draws buffer */ 1),
+        sizeof(u32) * DRAW_INDEX_TYPE_COUNT * (scene->mat_pipe_count + /* shadow map draws buffer */ MAX_SHADOW_CASCADES),
         (u32)0);
-    buffer_barrier(cmd, scene->scene_uniforms.handle, /* Offset: */ 0, VK_WHOLE_SIZE,
-        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT,
-        VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
     buffer_barrier(cmd, scene->counts_buffer.handle, /* Offset: */ 0, VK_WHOLE_SIZE,
         VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
         VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
-    // TEMP:TODO: END
     return true;
 }
 
@@ -1115,6 +2530,46 @@ b8 scene_frame_begin(scene* scene, renderer_state* state) {
         return false;
     } else VK_CHECK(result);
 
+    // Read back & reset the culling stats of the frame that last used this frame index
+    u32* cull_stats = (u32*)scene->counts_buffer.alloc.mapped + DRAW_INDEX_TYPE_COUNT * (scene->mat_pipe_count + MAX_SHADOW_CASCADES) + CULL_STAT_COUNT * state->swapchain.frame_index;
+    scene->culled_objects = cull_stats[0];
+    scene->culled_shadow_objects = cull_stats[1];
+    scene->occluded_objects = cull_stats[2];
+    scene->culled_clusters = cull_stats[3];
+    // Warned once per overflow rather than every frame it lasts
+    if (cull_stats[4] && !scene->dropped_draws) {
+        ETWARN("%u draws past the draw buffer capacity of %u were dropped.", cull_stats[4], MAX_DRAW_COMMANDS);
+    }
+    scene->dropped_draws = cull_stats[4];
+    if (cull_stats[5] && !scene->overflowed_light_clusters) {
+        ETWARN("%u light clusters are reached by more than %u lights, the lights past that are dropped.", cull_stats[5], LIGHT_CLUSTER_MAX_LIGHTS);
+    }
+    scene->overflowed_light_clusters = cull_stats[5];
+    etzero_memory(cull_stats, sizeof(u32) * CULL_STAT_COUNT);
+
+    // Read back the geometry pass time of the same frame
+    u32 first_timestamp = SCENE_TIMESTAMP_COUNT * state->swapchain.frame_index;
+    u32 valid_bits = state->device.timestamp_valid_bits;
+    if (valid_bits && scene->frames_submitted >= state->swapchain.image_count) {
+        u64 timestamps[SCENE_TIMESTAMP_COUNT];
+        result = vkGetQueryPoolResults(
+            state->device.handle,
+            scene->timestamp_pool,
+            first_timestamp,
+            SCENE_TIMESTAMP_COUNT,
+            sizeof(timestamps),
+            timestamps,
+            sizeof(u64),
+            VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            // Only the low timestampValidBits bits are meaningful, masking the differences also handles wrap around
+            u64 mask = (valid_bits >= 64) ? ~0ull : (1ull << valid_bits) - 1;
+            u64 ticks = ((timestamps[SCENE_TIMESTAMP_EARLY_GEOMETRY_END] - timestamps[SCENE_TIMESTAMP_EARLY_GEOMETRY_BEGIN]) & mask) +
+                ((timestamps[SCENE_TIMESTAMP_LATE_GEOMETRY_END] - timestamps[SCENE_TIMESTAMP_LATE_GEOMETRY_BEGIN]) & mask);
+            scene->geometry_pass_ms = (f32)ticks * state->device.gpu_limits.timestampPeriod / 1000000.0f;
+        }
+    }
+
     // Reset the render fence for reuse
     VK_CHECK(vkResetFences(
         state->device.handle,
@@ -1125,19 +2580,38 @@ b8 scene_frame_begin(scene* scene, renderer_state* state) {
     VK_CHECK(vkResetCommandBuffer(scene->graphics_command_buffers[state->swapchain.frame_index], 0));
     VkCommandBufferBeginInfo begin_info = init_command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VK_CHECK(vkBeginCommandBuffer(scene->graphics_command_buffers[state->swapchain.frame_index], &begin_info));
+    vkCmdResetQueryPool(scene->graphics_command_buffers[state->swapchain.frame_index], scene->timestamp_pool, first_timestamp, SCENE_TIMESTAMP_COUNT);
+
+    // Acquire ownership of resources uploaded since the last frame
+    scene->upload_wait_value = staging_acquire(state, scene->graphics_command_buffers[state->swapchain.frame_index]);
     return true;
 }
 
 void draw_command_generation(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
-    // Shadow draw command generation compute
-    u32 object_count = dynarray_length(scene->objects);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->draw_gen_layout, 0, 1, &scene->scene_set, 0, NULL);
-
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->shadow_draw_gen_pipeline);
-    vkCmdDispatch(cmd, ceil((f32)object_count / 32.0f), 1, 1);
+    // The previous frame's geometry & shadow passes are done reading the instance lists & shadow draws
+    // before they are rewritten
+    buffer_barrier(
+        cmd, scene->instance_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    buffer_barrier(
+        cmd, scene->shadow_draws.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
 
+    // One pass over the objects generates the draws of the camera & the shadow view
+    u32 object_count = dynarray_length(scene->objects);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->draw_gen_layout, 0, 1, &scene->scene_sets[state->swapchain.frame_index], 0, NULL);
+    scan_barrier(scene, cmd);
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->draw_gen_pipeline);
     vkCmdDispatch(cmd, ceil((f32)object_count / 32.0f), 1, 1);
+    cluster_draw_generation(scene, cmd, /* late: */ false);
+
+    // Shadow draws at the prefix sums of the shadow region, scanned with the other object regions
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->shadow_scatter_pipeline);
+    vkCmdDispatch(cmd, object_count / 32 + /* Count writer */ 1, 1, 1);
 
     // Wait for shadow draw generation before reading from indirect command buffer
     buffer_barrier(
@@ -1145,21 +2619,211 @@ void draw_command_generation(renderer_state* state, scene* scene, VkCommandBuffe
         VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
         VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
     buffer_barrier(
-        cmd, scene->counts_buffer.handle, sizeof(u32) * scene->mat_pipe_count, sizeof(u32),
+        cmd, scene->counts_buffer.handle, sizeof(u32) * DRAW_INDEX_TYPE_COUNT * scene->mat_pipe_count, sizeof(u32) * DRAW_INDEX_TYPE_COUNT * MAX_SHADOW_CASCADES,
         VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
         VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT
     );
 
+    material_draws_barrier(scene, cmd);
+}
+
+// Regenerates the material draw commands for the objects the early pass flagged as occluded
+// that are visible against the depth pyramid built from the early pass depth
+void late_draw_command_generation(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
+    // The early geometry pass is done reading the draw commands, counts & instance lists before they are regenerated
+    for (u32 i = 0; i < scene->mat_pipe_count; ++i) {
+        buffer_barrier(
+            cmd, scene->mat_pipes[i].draws_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+        );
+    }
+    buffer_barrier(
+        cmd, scene->instance_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    // Material draw counts are overwritten by instance draw generation, not accumulated
+    buffer_barrier(
+        cmd, scene->counts_buffer.handle, /* offset: */ 0, sizeof(u32) * DRAW_INDEX_TYPE_COUNT * scene->mat_pipe_count,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+
+    buffer_barrier(
+        cmd, scene->occlusion_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    scan_barrier(scene, cmd);
+
+    u32 object_count = dynarray_length(scene->objects);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->draw_gen_layout, 0, 1, &scene->scene_sets[state->swapchain.frame_index], 0, NULL);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->late_draw_gen_pipeline);
+    vkCmdDispatch(cmd, ceil((f32)object_count / 32.0f), 1, 1);
+    cluster_draw_generation(scene, cmd, /* late: */ true);
+
+    material_draws_barrier(scene, cmd);
+}
+
+// Binds the index buffer the draws of index_type read from
+static void bind_index_buffer(scene* scene, VkCommandBuffer cmd, index_type type) {
+    if (type == INDEX_TYPE_U16) {
+        vkCmdBindIndexBuffer(cmd, scene->index_buffer_u16.handle, 0, VK_INDEX_TYPE_UINT16);
+    } else {
+        vkCmdBindIndexBuffer(cmd, scene->index_buffer.handle, 0, VK_INDEX_TYPE_UINT32);
+    }
+}
+
+// Compacts the objects passing draws.comp into the cluster list & instance lists, & the visible clusters
+// into draw commands through prefix sums instead of atomics, a pipeline's draws are in object & meshlet order.
+// Expects the object visibility pass to be dispatched & the scene set bound to draw_gen_layout
+static void cluster_draw_generation(scene* scene, VkCommandBuffer cmd, b8 late) {
+    u32 object_count = dynarray_length(scene->objects);
+    u32 object_block_count = scan_block_count(object_count + 1);
+    u32 object_region_size = object_count + 1 + object_block_count;
+    u32 cluster_block_count = scan_block_count(scene->cluster_capacity + 1);
+    u32 cluster_sums_offset = OBJECT_SCAN_REGION_COUNT * object_region_size + scene->cluster_capacity + 1;
+    u32 level_block_count = scan_block_count(scene->instance_level_count + 1);
+    u32 level_offset = cluster_sums_offset + cluster_block_count;
+    u32 level_sums_offset = level_offset + scene->instance_level_count + 1;
+    u32 level_invocations = scene->data.instance_group_count * GEOMETRY_MAX_LODS;
+    // The late pass draws no shadows, the shadow region is left as the early pass scanned it
+    u32 object_region_count = late ? OBJECT_SCAN_SHADOW : OBJECT_SCAN_REGION_COUNT;
+
+    // Cluster offset of every object
+    scan_barrier(scene, cmd);
+    scan_push object_push = {
+        .offset = 0,
+        .value_count = object_count,
+        .scan_count = object_count + 1,
+        .sums_offset = object_count + 1,
+    };
+    vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push), &object_push);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->scan_block_pipeline);
+    vkCmdDispatch(cmd, object_block_count, 1, 1);
+    // Instance slots of every level of detail & shadow draws by index type, a region per workgroup row
+    scan_push pair_push = {
+        .offset = OBJECT_SCAN_INSTANCES * object_region_size,
+        .value_count = object_count,
+        .scan_count = object_count + 1,
+        .sums_offset = OBJECT_SCAN_INSTANCES * object_region_size + object_count + 1,
+        .region_stride = object_region_size,
+    };
+    vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push), &pair_push);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->scan_pair_pipeline);
+    vkCmdDispatch(cmd, object_block_count, object_region_count - OBJECT_SCAN_INSTANCES, 1);
+    scan_barrier(scene, cmd);
+    scan_push object_sums_push = {
+        .offset = object_count + 1,
+        .value_count = object_block_count,
+        .scan_count = object_block_count,
+        .region_stride = object_region_size,
+    };
+    vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push), &object_sums_push);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->scan_sums_pipeline);
+    vkCmdDispatch(cmd, 1, object_region_count, 1);
+    scan_barrier(scene, cmd);
+
+    // The previous cluster culling pass is done with the list & its header before they are rewritten
+    buffer_barrier(
+        cmd, scene->cluster_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->cluster_scatter_pipeline);
+    vkCmdDispatch(cmd, object_count / 32 + /* Header writer */ 1, 1, 1);
+    // Instance group levels of detail with visible instances, independent of the cluster list
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->instance_level_pipeline);
+    vkCmdDispatch(cmd, ceil((f32)level_invocations / 32.0f), 1, 1);
+    buffer_barrier(
+        cmd, scene->cluster_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    scan_barrier(scene, cmd);
+
+    // Visible draws of every cluster, scanned per block by cluster culling, & the instanced draws of
+    // every level of detail. The regions are disjoint, so the scans run without a barrier between
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->cluster_cull_pipeline);
+    vkCmdDispatchIndirect(cmd, scene->cluster_buffer.handle, /* Offset: */ 0);
+    scan_push level_push = {
+        .offset = level_offset,
+        .value_count = scene->instance_level_count,
+        .scan_count = scene->instance_level_count + 1,
+        .sums_offset = level_sums_offset,
+    };
+    vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push), &level_push);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->scan_pair_pipeline);
+    vkCmdDispatch(cmd, level_block_count, 1, 1);
+    scan_barrier(scene, cmd);
+    // NOTE: Totals past the blocks cluster culling wrote are stale, they only affect prefix sums past the list
+    scan_push cluster_sums_push = {
+        .offset = cluster_sums_offset,
+        .value_count = cluster_block_count,
+        .scan_count = cluster_block_count,
+    };
+    vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push), &cluster_sums_push);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->scan_sums_pipeline);
+    vkCmdDispatch(cmd, 1, 1, 1);
+    scan_push level_sums_push = {
+        .offset = level_sums_offset,
+        .value_count = level_block_count,
+        .scan_count = level_block_count,
+    };
+    vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push), &level_sums_push);
+    vkCmdDispatch(cmd, 1, 1, 1);
+    scan_barrier(scene, cmd);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->draw_scatter_pipeline);
+    vkCmdDispatchIndirect(cmd, scene->cluster_buffer.handle, /* Offset: */ 0);
+
+    // Instanced draws & the draw counts of every pipeline
+    u32 invocations = level_invocations;
+    if (invocations < scene->mat_pipe_count * DRAW_INDEX_TYPE_COUNT) {
+        invocations = scene->mat_pipe_count * DRAW_INDEX_TYPE_COUNT;
+    }
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->instance_draw_pipeline);
+    vkCmdDispatch(cmd, ceil((f32)invocations / 32.0f), 1, 1);
+}
+
+// Orders every access of the prefix sum regions between draw generation dispatches
+static void scan_barrier(scene* scene, VkCommandBuffer cmd) {
+    buffer_barrier(
+        cmd, scene->scan_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+}
+
+static u32 scan_block_count(u32 count) {
+    return (count + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE;
+}
+
+static void material_draws_barrier(scene* scene, VkCommandBuffer cmd) {
+    // Culling stats are read back on the host once the frame's fence is signaled
+    buffer_barrier(
+        cmd, scene->counts_buffer.handle, sizeof(u32) * (scene->data.cull_stats_id), sizeof(u32) * CULL_STAT_COUNT,
+        VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_HOST_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_HOST_BIT
+    );
+
+    buffer_barrier(
+        cmd, scene->instance_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT
+    );
+
     // NOTE: Clean this up
     for (u32 i = 0; i < scene->mat_pipe_count; ++i) {
         buffer_barrier(
             cmd, scene->mat_pipes[i].draws_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
-            VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
-            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT
+            VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT
         );
     }
     buffer_barrier(
-        cmd, scene->counts_buffer.handle, /* offset: */ 0, sizeof(u32) * scene->mat_pipe_count,
+        cmd, scene->counts_buffer.handle, /* offset: */ 0, sizeof(u32) * DRAW_INDEX_TYPE_COUNT * scene->mat_pipe_count,
         VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
         VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT
     );
@@ -1169,11 +2833,130 @@ void draw_command_generation(renderer_state* state, scene* scene, VkCommandBuffe
 void shadow_pass(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
     VkRenderingAttachmentInfo depth_attachment = init_depth_attachment_info(
         scene->shadow_map.view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-    
+    // NOTE: A clear covers every layer of the pass, the rerendered layers are cleared one by one below
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    // NOTE: Texels outside the render area keep their cached depth, the clear only covers it
+    VkRect2D render_rect = scene->shadow_render_area;
+    VkRenderingInfo render_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .pNext = 0,
+        .renderArea = render_rect,
+        .layerCount = scene->shadow_cascade_count,
+        .pDepthAttachment = &depth_attachment,
+        .pStencilAttachment = 0,
+    };
+
+    vkCmdBeginRendering(cmd, &render_info);
+
+    VkViewport viewport = {
+        .width = scene->shadow_map.extent.width,
+        .height = scene->shadow_map.extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f};
+    VkRect2D scissor = render_rect;
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->draw_gen_layout, 0, 1, &scene->scene_sets[state->swapchain.frame_index], 0, NULL);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->shadow_pipeline);
+
+    // Each cascade's draws were culled against its own box & render to its layer through gl_Layer
+    for (u32 cascade = 0; cascade < scene->shadow_cascade_count; ++cascade) {
+        if (!(scene->shadow_cascade_mask & (1u << cascade))) continue;
+
+        VkClearAttachment clear = {
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .clearValue.depthStencil.depth = 0.0f,
+        };
+        VkClearRect clear_rect = {
+            .rect = render_rect,
+            .baseArrayLayer = cascade,
+            .layerCount = 1,
+        };
+        vkCmdClearAttachments(cmd, 1, &clear, 1, &clear_rect);
+
+        for (u32 type = 0; type < DRAW_INDEX_TYPE_COUNT; ++type) {
+            bind_index_buffer(scene, cmd, type);
+            draw_push push = {
+                .draw_offset = MAX_DRAW_COMMANDS * (DRAW_INDEX_TYPE_COUNT * cascade + type),
+                .shadow_cascade = cascade,
+            };
+            vkCmdPushConstants(cmd, scene->draw_gen_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw_push), &push);
+            vkCmdDrawIndexedIndirectCount(cmd,
+                scene->shadow_draws.handle,
+                sizeof(draw_command) * push.draw_offset,
+                scene->counts_buffer.handle,
+                sizeof(u32) * (DRAW_INDEX_TYPE_COUNT * (scene->mat_pipe_count + cascade) + type),
+                MAX_DRAW_COMMANDS,
+                sizeof(draw_command)
+            );
+        }
+    }
+
+    vkCmdEndRendering(cmd);
+}
+
+// Writes the transforms moved by scene_transform_set since the last frame to the transform buffer
+static void transform_upload(scene* scene, VkCommandBuffer cmd) {
+    u32 dirty_count = dynarray_length(scene->dirty_transforms);
+    if (!dirty_count) return;
+
+    // Previous frames' draws are done reading the transforms before they are overwritten
+    buffer_barrier(
+        cmd, scene->transform_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT
+    );
+    for (u32 i = 0; i < dirty_count; ++i) {
+        u32 transform_id = scene->dirty_transforms[i];
+        vkCmdUpdateBuffer(cmd, scene->transform_buffer.handle,
+            sizeof(affine_transform) * transform_id, sizeof(affine_transform), &scene->transforms[transform_id]);
+    }
+    buffer_barrier(
+        cmd, scene->transform_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    dynarray_clear(scene->dirty_transforms);
+}
+
+// Bins the point lights into the froxels of the camera frustum, read by the material fragment shaders
+static void light_culling(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
+    // The previous frame's geometry passes are done reading the light lists before they are rewritten
+    buffer_barrier(
+        cmd, scene->light_cluster_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+    );
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->draw_gen_layout, 0, 1, &scene->scene_sets[state->swapchain.frame_index], 0, NULL);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->light_cull_pipeline);
+    vkCmdDispatch(cmd, ceil((f32)LIGHT_CLUSTER_COUNT / 64.0f), 1, 1);
+    buffer_barrier(
+        cmd, scene->light_cluster_buffer.handle, /* Offset */ 0, VK_WHOLE_SIZE,
+        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT
+    );
+    // The light overflow stat is read back on the host along with the other culling stats
+    buffer_barrier(
+        cmd, scene->counts_buffer.handle, sizeof(u32) * (scene->data.cull_stats_id + CULL_STAT_COUNT - 1), sizeof(u32),
+        VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_HOST_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_HOST_BIT
+    );
+}
+
+// Depth only pass over the opaque material draws, the geometry pass then shades the surfaces that
+// match its depth. Alpha tested materials run their alpha test so no depth is written where they discard
+static void depth_prepass(renderer_state* state, scene* scene, VkCommandBuffer cmd, b8 late) {
+    VkRenderingAttachmentInfo depth_attachment = init_depth_attachment_info(
+        scene->depth_image.view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    if (late) {
+        depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
     VkRect2D render_rect = {
         .extent = {
-            .width = scene->shadow_map.extent.width,
-            .height = scene->shadow_map.extent.height,
+            .width = scene->render_extent.width,
+            .height = scene->render_extent.height,
         },
     };
     VkRenderingInfo render_info = {
@@ -1196,30 +2979,57 @@ void shadow_pass(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
     vkCmdSetViewport(cmd, 0, 1, &viewport);
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    vkCmdBindIndexBuffer(cmd, scene->index_buffer.handle, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->draw_gen_layout, 0, 1, &scene->scene_set, 0, NULL);
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->shadow_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipeline_layout, 0, 1, &scene->scene_sets[state->swapchain.frame_index], 0, NULL);
 
-    vkCmdDrawIndexedIndirectCount(cmd,
-        scene->shadow_draws.handle,
-        /* Offset: */ 0,
-        scene->counts_buffer.handle,
-        sizeof(u32) * scene->mat_pipe_count,
-        MAX_DRAW_COMMANDS,
-        sizeof(draw_command)
-    );
+    for (u32 type = 0; type < DRAW_INDEX_TYPE_COUNT; ++type) {
+        bind_index_buffer(scene, cmd, type);
+        for (u32 i = 0; i < scene->mat_pipe_count; ++i) {
+            if (scene->mat_pipes[i].prepass_pipe == VK_NULL_HANDLE) {
+                continue;
+            }
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipes[i].prepass_pipe);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipeline_layout, 1, 1, &scene->mat_pipes[i].set, 0, NULL);
+
+            draw_push push = {
+                .draw_offset = MAX_DRAW_COMMANDS * type,
+                .inst_stride = scene->mat_pipes[i].inst_size / sizeof(u32),
+            };
+            vkCmdPushConstants(cmd, scene->mat_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw_push), &push);
+            vkCmdDrawIndexedIndirectCount(cmd,
+                scene->mat_pipes[i].draws_buffer.handle,
+                sizeof(draw_command) * push.draw_offset,
+                scene->counts_buffer.handle,
+                sizeof(u32) * (DRAW_INDEX_TYPE_COUNT * i + type),
+                MAX_DRAW_COMMANDS,
+                sizeof(draw_command)
+            );
+        }
+    }
 
     vkCmdEndRendering(cmd);
 }
 
-void geometry_pass(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
+// The late pass draws on top of the early pass, so it loads the attachments instead of clearing them.
+// With the depth prepass the opaque pipelines shade only the fragments matching the prepass depth
+void geometry_pass(renderer_state* state, scene* scene, VkCommandBuffer cmd, b8 late) {
+    if (scene->depth_prepass) {
+        depth_prepass(state, scene, cmd, late);
+        image_barrier(cmd, scene->depth_image.handle, scene->depth_image.aspects,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT);
+    }
+
     VkClearValue clear_color = {
         .color = {.3f,0.f,.2f,0.f},
     };
     VkRenderingAttachmentInfo color_attachment = init_color_attachment_info(
-        scene->render_image.view, &clear_color, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        scene->render_image.view, late ? NULL : &clear_color, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     VkRenderingAttachmentInfo depth_attachment = init_depth_attachment_info(
         scene->depth_image.view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    if (late || scene->depth_prepass) {
+        depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
 
     VkExtent2D render_extent = {.width = scene->render_extent.width, .height = scene->render_extent.height};
     VkRenderingInfo render_info = init_rendering_info(render_extent, &color_attachment, &depth_attachment);
@@ -1244,22 +3054,31 @@ void geometry_pass(renderer_state* state, scene* scene, VkCommandBuffer cmd) {
 
     vkCmdSetScissor(cmd, 0, 1, &scissor);
     
-    vkCmdBindIndexBuffer(cmd, scene->index_buffer.handle, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipeline_layout, 0, 1, &scene->scene_set, 0, NULL);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipeline_layout, 0, 1, &scene->scene_sets[state->swapchain.frame_index], 0, NULL);
+
+    // NOTE: Index type outermost so each index buffer is bound once
+    for (u32 type = 0; type < DRAW_INDEX_TYPE_COUNT; ++type) {
+        bind_index_buffer(scene, cmd, type);
+        draw_push push = {.draw_offset = MAX_DRAW_COMMANDS * type};
+        vkCmdPushConstants(cmd, scene->mat_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw_push), &push);
+        for (u32 i = 0; i < scene->mat_pipe_count; ++i) {
+            VkPipeline pipe = scene->mat_pipes[i].pipe;
+            if (scene->depth_prepass && scene->mat_pipes[i].equal_pipe != VK_NULL_HANDLE) {
+                pipe = scene->mat_pipes[i].equal_pipe;
+            }
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe);
 
-    for (u32 i = 0; i < scene->mat_pipe_count; ++i) {
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipes[i].pipe);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipeline_layout, 1, 1, &scene->mat_pipes[i].set, 0, NULL);
 
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->mat_pipeline_layout, 1, 1, &scene->mat_pipes[i].set, 0, NULL);
-        
-        vkCmdDrawIndexedIndirectCount(cmd,
-            scene->mat_pipes[i].draws_buffer.handle,
-            /* Offset: */ 0,
-            scene->counts_buffer.handle,
-            sizeof(u32) * i,
-            MAX_DRAW_COMMANDS,
-            sizeof(draw_command)
-        );
+            vkCmdDrawIndexedIndirectCount(cmd,
+                scene->mat_pipes[i].draws_buffer.handle,
+                sizeof(draw_command) * push.draw_offset,
+                scene->counts_buffer.handle,
+                sizeof(u32) * (DRAW_INDEX_TYPE_COUNT * i + type),
+                MAX_DRAW_COMMANDS,
+                sizeof(draw_command)
+            );
+        }
     }
     vkCmdEndRendering(cmd);
 }
@@ -1268,20 +3087,45 @@ b8 scene_frame_end(scene* scene, renderer_state* state) {
     VkResult result;
     VkCommandBuffer frame_cmd = scene->graphics_command_buffers[state->swapchain.frame_index];
 
+    transform_upload(scene, frame_cmd);
+
     // Generate draw commands
     draw_command_generation(state, scene, frame_cmd);
+    light_culling(state, scene, frame_cmd);
     
-    // Get shadow map ready to render to
-    image_barrier(frame_cmd, scene->shadow_map.handle, scene->shadow_map.aspects,
-        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-        VK_ACCESS_2_NONE, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
-    shadow_pass(state, scene, frame_cmd);
-    // Do not sample from shadow map until the shadow pass has reached
-    image_barrier(frame_cmd, scene->shadow_map.handle, scene->shadow_map.aspects,
-        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
-        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
-        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+    // Cached layers are left as they are, the shadow pass is skipped when none are out of date
+    if (scene->shadow_cascade_mask) {
+        // Get shadow map ready to render to, keeping the depth of the layers' other texels
+        if (scene->shadow_map_initialized) {
+            image_barrier(frame_cmd, scene->shadow_map.handle, scene->shadow_map.aspects,
+                VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
+        } else {
+            image_barrier(frame_cmd, scene->shadow_map.handle, scene->shadow_map.aspects,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                VK_ACCESS_2_NONE, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
+        }
+        shadow_pass(state, scene, frame_cmd);
+        // Do not sample from shadow map until the shadow pass has reached
+        image_barrier(frame_cmd, scene->shadow_map.handle, scene->shadow_map.aspects,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+    }
+    // The layers now hold what cascade_viewprojs describes
+    for (u32 i = 0; i < scene->shadow_cascade_count; ++i) {
+        scene->cascades[i] = scene->cascade_targets[i];
+        scene->caster_boxes[i] = scene->caster_box_targets[i];
+    }
+    scene->shadow_sun_direction = scene->data.sun.direction;
+    scene->shadow_map_initialized |= scene->shadow_cascade_mask != 0;
+    if (scene->shadow_fit_version == scene->shadow_dirty_version) {
+        scene->shadow_cache_valid = true;
+        scene->shadow_casters_moved = false;
+    }
+    scene->shadow_frame++;
 
     // Get color attachment and depth attachment ready to render to
     image_barrier(frame_cmd, scene->render_image.handle, scene->render_image.aspects,
@@ -1292,7 +3136,42 @@ b8 scene_frame_end(scene* scene, renderer_state* state) {
         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
         VK_ACCESS_2_NONE, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
         VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
-    geometry_pass(state, scene, frame_cmd);
+    // Queue families with no valid timestamp bits cannot time the geometry passes
+    b8 timestamps = state->device.timestamp_valid_bits != 0;
+    u32 first_timestamp = SCENE_TIMESTAMP_COUNT * state->swapchain.frame_index;
+    if (timestamps) {
+        vkCmdWriteTimestamp2(frame_cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, scene->timestamp_pool, first_timestamp + SCENE_TIMESTAMP_EARLY_GEOMETRY_BEGIN);
+    }
+    geometry_pass(state, scene, frame_cmd, /* late: */ false);
+    if (timestamps) {
+        vkCmdWriteTimestamp2(frame_cmd, VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, scene->timestamp_pool, first_timestamp + SCENE_TIMESTAMP_EARLY_GEOMETRY_END);
+    }
+
+    // Build the depth pyramid from the early pass depth, occlusion tests from the
+    // next frame's early pass also read it. The last level barrier covers those reads
+    image_barrier(frame_cmd, scene->depth_image.handle, scene->depth_image.aspects,
+        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    depth_pyramid_build(&scene->depth_pyramid, frame_cmd);
+
+    late_draw_command_generation(state, scene, frame_cmd);
+
+    image_barrier(frame_cmd, scene->depth_image.handle, scene->depth_image.aspects,
+        VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
+    image_barrier(frame_cmd, scene->render_image.handle, scene->render_image.aspects,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+    if (timestamps) {
+        vkCmdWriteTimestamp2(frame_cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, scene->timestamp_pool, first_timestamp + SCENE_TIMESTAMP_LATE_GEOMETRY_BEGIN);
+    }
+    geometry_pass(state, scene, frame_cmd, /* late: */ true);
+    if (timestamps) {
+        vkCmdWriteTimestamp2(frame_cmd, VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, scene->timestamp_pool, first_timestamp + SCENE_TIMESTAMP_LATE_GEOMETRY_END);
+    }
 
     // Make render image optimal layout for transfer source to swapchain image
     image_barrier(frame_cmd, scene->render_image.handle, scene->render_image.aspects,
@@ -1323,9 +3202,17 @@ b8 scene_frame_end(scene* scene, renderer_state* state) {
 
     VK_CHECK(vkEndCommandBuffer(frame_cmd));
 
-    VkSemaphoreSubmitInfo wait_submit = init_semaphore_submit_info(
+    VkSemaphoreSubmitInfo wait_submits[2];
+    u32 wait_count = 0;
+    wait_submits[wait_count++] = init_semaphore_submit_info(
         state->swapchain.image_acquired[state->swapchain.frame_index],
         VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT);
+    if (scene->upload_wait_value) {
+        wait_submits[wait_count] = init_semaphore_submit_info(
+            state->staging.timeline,
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+        wait_submits[wait_count++].value = scene->upload_wait_value;
+    }
 
     VkCommandBufferSubmitInfo cmd_submit = init_command_buffer_submit_info(frame_cmd);
     
@@ -1334,7 +3221,7 @@ b8 scene_frame_end(scene* scene, renderer_state* state) {
         VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT);
 
     VkSubmitInfo2 submit_info = init_submit_info2(
-        1, &wait_submit,
+        wait_count, wait_submits,
         1, &cmd_submit,
         1, &signal_submit);
     
@@ -1359,6 +3246,10 @@ b8 scene_frame_end(scene* scene, renderer_state* state) {
         recreate_swapchain(state, &state->swapchain);
     } else VK_CHECK(result);
 
+    // Every frame from here on has a depth pyramid from the frame before it
+    scene->data.occlusion_enabled = 1;
+    scene->frames_submitted++;
+
     state->swapchain.frame_index = (state->swapchain.frame_index + 1) % state->swapchain.image_count;
     return true;
 }
@@ -1377,17 +3268,21 @@ void scene_texture_set(scene* scene, u32 tex_id, u32 img_id, u32 sampler_id) {
         .descriptorCount = 1,
         .dstArrayElement = tex_id,
         .dstBinding = SCENE_SET_TEXTURES_BINDING,
-        .dstSet = scene->scene_set,
+        .dstSet = scene->scene_sets[0],
         .pImageInfo = &image_info,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
     };
-    vkUpdateDescriptorSets(
-        scene->state->device.handle,
-        /* WriteCount: */ 1,
-        &img_write,
-        /* CopyCount: */ 0,
-        /* Copies: */ NULL
-    );
+    // Textures are shared by every frame so each frame's scene set gets the write
+    for (u32 i = 0; i < scene->state->swapchain.image_count; ++i) {
+        img_write.dstSet = scene->scene_sets[i];
+        vkUpdateDescriptorSets(
+            scene->state->device.handle,
+            /* WriteCount: */ 1,
+            &img_write,
+            /* CopyCount: */ 0,
+            /* Copies: */ NULL
+        );
+    }
 }
 // TODO: END
 
@@ -1423,6 +3318,26 @@ static b8 scene_on_key_event(u16 code, void* scne, event_data data) {
             s->data.debug_view = (s->data.debug_view) ? s->data.debug_view - 1 : DEBUG_VIEW_TYPE_MAX - 1;
             break;
         }
+        case KEY_LEFT_BRACKET:
+            s->data.lod_threshold *= 0.5f;
+            break;
+        case KEY_RIGHT_BRACKET:
+            s->data.lod_threshold *= 2.0f;
+            break;
+        case KEY_Z:
+            s->depth_prepass = !s->depth_prepass;
+            ETINFO("Depth prepass %s.", s->depth_prepass ? "enabled" : "disabled");
+            break;
+        case KEY_X:
+            s->shadow_receiver_culling = !s->shadow_receiver_culling;
+            ETINFO("Shadow receiver culling %s.", s->shadow_receiver_culling ? "enabled" : "disabled");
+            break;
+        case KEY_V: {
+            static const char* filter_names[SHADOW_FILTER_MAX] = {"PCF 3x3", "PCF 5x5", "PCF 7x7", "PCSS"};
+            s->data.shadow_filter = (s->data.shadow_filter + 1) % SHADOW_FILTER_MAX;
+            ETINFO("Shadow filter %s.", filter_names[s->data.shadow_filter]);
+            break;
+        }
     }
     return false;
 }
\ No newline at end of file
@@ -14,6 +14,11 @@ typedef struct scene_config {
     u32 resolution_height;
     import_payload* import_payload;
     renderer_state* renderer_state;
+    b8 depth_prepass;   // Initial depth prepass mode, toggled with Z
+    u32 shadow_cascade_count;   // [1, MAX_SHADOW_CASCADES]
+    f32 shadow_distance;        // View depth the last shadow cascade ends at
+    b8 shadow_receiver_culling; // Initial shadow receiver culling mode, toggled with X
+    u32 shadow_filter;          // Initial shadow_filter_type, cycled with V
 } scene_config;
 
 b8 scene_init(scene** scn, scene_config config);
@@ -26,4 +31,7 @@ b8 scene_frame_end(scene* scene, renderer_state* state);
 
 b8 scene_render(scene* scene, renderer_state* state);
 
+// Moves every object using the transform, the shadow map is only rerendered where their shadows were & will be
+void scene_transform_set(scene* scene, u32 transform_id, m4s transform);
+
 void scene_shutdown(scene* scene);
\ No newline at end of file
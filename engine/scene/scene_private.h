@@ -1,6 +1,7 @@
 #pragma once
 #include "defines.h"
 #include "scene/scene_types.h"
+#include "renderer/src/depth_pyramid.h"
 
 #include "core/camera.h"
 #include "core/clock.h"
@@ -22,49 +23,132 @@ typedef struct scene {
     camera cam;
     scene_data data;
 
-    vertex* vertices;       // dynarray
-    u32* indices;           // dynarray
-    m4s* transforms;        // dynarray
+    packed_position* positions;     // dynarray
+    packed_attributes* attributes;  // dynarray, parallel to positions
+    u32* colors;            // dynarray, RGBA8 vertex colors of the geometries that have them
+    u32* indices;           // dynarray, geometries with INDEX_TYPE_U32
+    u16* indices_u16;       // dynarray, geometries with INDEX_TYPE_U16
+    affine_transform* transforms;   // dynarray
     geometry* geometries;   // dynarray
-    object* objects;        // dynarray
+    meshlet* meshlets;      // dynarray
+    object* objects;        // dynarray, sorted so the objects of an instance group are contiguous
+    u32* transform_object_offsets;  // First entry of each transform in transform_objects, transform count + 1
+    u32* transform_objects;         // Object indices grouped by transform, built once the objects are sorted
+    instance_group* instance_groups;    // dynarray
+    point_light* lights;    // dynarray, the light following the camera first
     // NOTE: END
 
     // NOTE: GPU Memory Buffers
-    buffer vertex_buffer;
+    buffer position_buffer;     // Read alone by depth only passes
+    buffer attribute_buffer;
+    buffer color_buffer;
     buffer index_buffer;
+    buffer index_buffer_u16;
     buffer transform_buffer;
 
-    buffer scene_uniforms;      // Per Frame Uniform data
+    buffer scene_uniforms;      // Per Frame Uniform data, one slice per frame in flight
+    u64 scene_uniforms_stride;
     buffer object_buffer;       // Contains Object information used to generate draws
     buffer geometry_buffer;
+    buffer meshlet_buffer;
+    buffer instance_group_buffer;
+    buffer instance_buffer;     // Transform index per object followed by the visible instance lists of the groups
+    buffer pipe_range_buffer;   // pipe_range per material pipeline
 
-    buffer counts_buffer;        // Holds the counts for each pipeline draw indirect
+    buffer counts_buffer;        // Holds the counts of each draw buffer per index type followed by per frame culling stats
     buffer draws_buffer;         // Holds pointers to each material pipelines draw buffers
+    buffer occlusion_buffer;     // Per object flag, set when the early pass rejected it by occlusion
+    buffer cluster_buffer;       // Indirect dispatch header followed by the meshlets left after object culling
+    u32 cluster_capacity;        // Meshlets across every object
+    u32 instance_level_count;    // Levels of detail across the instance groups
+    buffer scan_buffer;          // Prefix sum regions of draw generation, see scan.glsl
+
+    buffer light_buffer;         // Point lights, one slice per frame in flight written from the host in scene_render
+    u64 light_buffer_stride;
+    buffer light_cluster_buffer; // Light count of every froxel followed by their light indices, see lights.glsl
 
     // NOTE: Render image, depth image
     VkExtent3D render_extent;
     image render_image;
     image depth_image;
 
+    // NOTE: Hi-Z occlusion culling, rebuilt from the early pass depth every frame
+    depth_pyramid depth_pyramid;
+    m4s pyramid_viewproj;       // viewproj the depth pyramid was rendered with
+
     // NOTE: Index into draws_buffer for shadow_draws is a scene_data struct member
     buffer shadow_draws;                    // Draw command buffer for indirect drawing
-    image shadow_map;                       // Depth map on shadow pass, sampler2D on lighting pass
+    image shadow_map;                       // Layer per cascade, routed by gl_Layer & sampled as a sampler2DArray
+    u32 shadow_cascade_count;
+    f32 shadow_distance;
+    v4s bounds;                             // World space bounding sphere of every object, shadow casters outside the cascades are kept
     VkSampler shadow_map_sampler;
-    VkPipeline shadow_draw_gen_pipeline;    // Uses draw_gen_layout as VkPipelineLayout
-    VkPipeline shadow_pipeline;             // Pipeline to render to the shadow map
+    VkSampler shadow_compare_sampler;       // Compares against the reference depth, hardware PCF
+    VkPipeline shadow_pipeline;
+
+    // NOTE: Shadow map caching. The layers keep their depth between frames & are only rerendered
+    // when their cascade moves or a shadow caster moves inside them
+    shadow_cascade cascades[MAX_SHADOW_CASCADES];           // Boxes the layers were last rendered with
+    shadow_cascade cascade_targets[MAX_SHADOW_CASCADES];    // Boxes of this frame, committed once the shadow pass is recorded
+    v4s shadow_sun_direction;               // Sun direction the layers were rendered with
+    shadow_cascade caster_boxes[MAX_SHADOW_CASCADES];       // Boxes the layers' casters were culled against, see shadow_cascades_fit
+    shadow_cascade caster_box_targets[MAX_SHADOW_CASCADES]; // Caster boxes of this frame, committed with cascade_targets
+    b8 shadow_receiver_culling;             // Clips the caster boxes to the receivers, toggled with X
+    b8 shadow_map_initialized;              // Set once the first shadow pass is recorded, the layers are in DEPTH_READ_ONLY_OPTIMAL
+    b8 shadow_cache_valid;                  // False until the first shadow pass & after the scene bounds grow
+    u32 shadow_cascade_mask;                // Layers rerendered this frame, 0 skips the shadow pass
+    VkRect2D shadow_render_area;            // Texels of those layers rerendered this frame
+    b8 shadow_casters_moved;
+    v4s shadow_dirty_rect;                  // Light space (min x, min y, max x, max y) of the casters moved since the last shadow pass
+    u32 shadow_dirty_version;               // Bumped by every caster move, casters moved after the frame's cascades were fit stay dirty
+    u32 shadow_fit_version;                 // shadow_dirty_version the frame's cascades were fit with
+    u64 shadow_frame;                       // Staggers the updates of the far cascades
+    u32* dirty_transforms;                  // dynarray, transforms to upload before the next frame's draws
 
     VkFence* render_fences;
     VkCommandPool* graphics_pools;
     VkCommandBuffer* graphics_command_buffers;
+    // Staging ring timeline value the frame being recorded waits on, 0 for none
+    u64 upload_wait_value;
+
+    // Objects culled by the most recently completed frame
+    u32 culled_objects;
+    u32 culled_shadow_objects;
+    u32 occluded_objects;
+    u32 culled_clusters;
+    // Draws dropped past the capacity of their draw buffer
+    u32 dropped_draws;
+    // Froxels that reached more than LIGHT_CLUSTER_MAX_LIGHTS lights
+    u32 overflowed_light_clusters;
+
+    // SCENE_TIMESTAMP_COUNT queries per frame in flight
+    VkQueryPool timestamp_pool;
+    u64 frames_submitted;                   // Timestamps are read once every frame index has been used
+    f32 geometry_pass_ms;                   // GPU time of the most recently completed frame's geometry passes
+
+    // Opaque pipelines lay down depth in a depth only pass & shade with EQUAL depth testing,
+    // trading a second vertex pass for no overdraw in the shading pass
+    b8 depth_prepass;
 
     VkDescriptorPool descriptor_pool;
 
     VkPipeline draw_gen_pipeline;
+    VkPipeline late_draw_gen_pipeline;     // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline cluster_cull_pipeline;      // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline instance_level_pipeline;    // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline instance_draw_pipeline;     // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline scan_block_pipeline;        // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline scan_sums_pipeline;         // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline scan_pair_pipeline;         // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline cluster_scatter_pipeline;   // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline shadow_scatter_pipeline;    // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline draw_scatter_pipeline;      // Uses draw_gen_layout as VkPipelineLayout
+    VkPipeline light_cull_pipeline;        // Uses draw_gen_layout as VkPipelineLayout
     VkPipelineLayout draw_gen_layout;
     
     // NOTE: PSOs must implement SET 0 to match this layout & retrieve the information
     VkDescriptorSetLayout scene_set_layout;
-    VkDescriptorSet scene_set;
+    VkDescriptorSet* scene_sets;    // One per frame in flight
 
     // NOTE: Currenly material pipelines are all hardcoded to
     // To have the same descriptor set layout and pipeline layouts
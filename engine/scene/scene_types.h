@@ -4,9 +4,101 @@
 #include "renderer/src/vk_types.h"
 #include "resources/material.h"
 
-#define MAX_DRAW_COMMANDS 8192
+// NOTE: Draws are per visible meshlet, this is the capacity of each material pipeline's draw buffer
+#define MAX_DRAW_COMMANDS 65536
 #define MAX_OBJECTS 8192
 
+// NOTE: Instanced objects skip cluster culling, so a mesh is only grouped once it is repeated often
+// enough that the saved per object draws outweigh the clusters no longer culled. Below this count
+// repeated objects keep their per cluster draws
+#define INSTANCE_GROUP_MIN_OBJECTS 16
+
+// NOTE: Each draw buffer holds MAX_DRAW_COMMANDS 32 bit index draws followed by as many 16 bit index
+// draws. The counts of draw buffer slot i are counts[DRAW_INDEX_TYPE_COUNT * i + index_type]. The shadow
+// draw buffer repeats this per cascade, each cascade's counts take a slot of their own
+#define DRAW_INDEX_TYPE_COUNT 2
+
+// Vertex stage push constant of material & shadow pipelines, where this draw call's commands begin
+typedef struct draw_push {
+    u32 draw_offset;
+    u32 inst_stride;    // Material instance size in u32s, read by the depth prepass
+    u32 shadow_cascade; // Cascade & shadow map layer the shadow pipeline's draws render to
+} draw_push;
+
+// NOTE: Must match scan.glsl. Draw generation compacts through prefix sums over blocks of this many elements
+#define SCAN_BLOCK_SIZE 256
+
+// NOTE: Must match scan.glsl. Regions over the objects at the start of the scan buffer, each followed
+// by its block totals: cluster counts, visible instances of two levels of detail each & shadow draws of each cascade
+#define OBJECT_SCAN_CLUSTERS 0
+#define OBJECT_SCAN_INSTANCES 1
+#define OBJECT_SCAN_SHADOW (OBJECT_SCAN_INSTANCES + GEOMETRY_MAX_LODS / 2)
+#define OBJECT_SCAN_REGION_COUNT (OBJECT_SCAN_SHADOW + MAX_SHADOW_CASCADES)
+
+// Compute push constant of prefix_sum.comp, see scan_constants there
+typedef struct scan_push {
+    u32 offset;
+    u32 value_count;
+    u32 scan_count;
+    u32 sums_offset;
+    u32 region_stride;
+} scan_push;
+
+// Objects & instance group levels of detail of a material pipeline, contiguous as both are sorted by
+// pipeline. Each index type's draws of the pipeline begin with its levels that have visible instances
+typedef struct pipe_range {
+    u32 first_object;
+    u32 object_end;
+    u32 first_level;
+    u32 level_end;
+} pipe_range;
+
+// NOTE: Must match input_structures.glsl. Point lights are binned into a grid of froxels, screen tiles split
+// into exponential depth slices, & fragments only shade the lights of their froxel
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+#define LIGHT_CLUSTER_MAX_LIGHTS 128
+#define MAX_POINT_LIGHTS 4096
+
+// Radiance below which a light without a range is cut off, see light_range
+#define LIGHT_CUTOFF_RADIANCE 0.01f
+
+// Camera clip distances, reverse z swaps them in the projection
+#define CAMERA_Z_NEAR 0.1f
+#define CAMERA_Z_FAR 1000.f
+#define CAMERA_FOV_Y 70.f   // Degrees
+
+// Shadow map resolution of each cascade
+#define SHADOW_CASCADE_RESOLUTION 2048
+// Blend of logarithmic (1) & uniform (0) cascade splits
+#define SHADOW_CASCADE_SPLIT_LAMBDA 0.75f
+// Texels per side of the tiles a partial shadow map update is rounded out to
+#define SHADOW_TILE_SIZE 128
+
+// Light space box covered by the orthographic projection of a shadow cascade, +z faces the sun
+typedef struct shadow_cascade {
+    v3s min;
+    v3s max;
+} shadow_cascade;
+
+// Default projected error in pixels a level of detail may have to be picked, [ & ] halve & double it
+#define LOD_ERROR_THRESHOLD_PIXELS 1.0f
+
+// Per frame culling counters: frustum culled objects, shadow culled objects, occluded objects, culled clusters,
+// draws dropped past the capacity of their draw buffer & froxels that dropped lights past LIGHT_CLUSTER_MAX_LIGHTS
+#define CULL_STAT_COUNT 6
+
+// GPU timestamps written per frame, the geometry pass time is the sum of both passes
+typedef enum scene_timestamp {
+    SCENE_TIMESTAMP_EARLY_GEOMETRY_BEGIN = 0,
+    SCENE_TIMESTAMP_EARLY_GEOMETRY_END,
+    SCENE_TIMESTAMP_LATE_GEOMETRY_BEGIN,
+    SCENE_TIMESTAMP_LATE_GEOMETRY_END,
+    SCENE_TIMESTAMP_COUNT,
+} scene_timestamp;
+
 // TODO: Read from shader reflection data.
 // NOTE: Spirv-reflect is dereferencing a null pointer on me at the moment
 typedef enum scene_set_bindings {
@@ -15,8 +107,20 @@ typedef enum scene_set_bindings {
     SCENE_SET_DRAW_BUFFERS_BINDING,
     SCENE_SET_OBJECTS_BINDING,
     SCENE_SET_GEOMETRIES_BINDING,
-    SCENE_SET_VERTICES_BINDING,
+    SCENE_SET_POSITIONS_BINDING,
     SCENE_SET_TRANSFORMS_BINDING,
+    SCENE_SET_OCCLUSION_BINDING,
+    SCENE_SET_MESHLETS_BINDING,
+    SCENE_SET_CLUSTERS_BINDING,
+    SCENE_SET_COLORS_BINDING,
+    SCENE_SET_ATTRIBUTES_BINDING,
+    SCENE_SET_INSTANCE_GROUPS_BINDING,
+    SCENE_SET_INSTANCES_BINDING,
+    SCENE_SET_PIPE_RANGES_BINDING,
+    SCENE_SET_SCAN_BINDING,
+    SCENE_SET_LIGHTS_BINDING,
+    SCENE_SET_LIGHT_CLUSTERS_BINDING,
+    // NOTE: Variable descriptor count binding, must be last
     SCENE_SET_TEXTURES_BINDING,
     SCENE_SET_BINDING_MAX,
 } scene_set_bindings;